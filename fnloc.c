@@ -1,6 +1,6 @@
 /*
  * FILE
- *      fnloc.c - version 2.2.1
+ *      fnloc.c - version 2.3.0
  * NAME
  *      Copyright 2018 Richard B. Romig
  * EMAIL
@@ -100,30 +100,55 @@
  * with this program. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L	/* for clock_gettime() */
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <string.h>
 #include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#include <dirent.h>
+#endif
 #include "fnloc.h"
 
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+#ifndef S_ISDIR
+#define S_ISDIR(mode) (((mode) & S_IFMT) == S_IFDIR)
+#endif
+
 int main(int argc, char *argv[])
 {
-	/* buffers */
-	char buffer[BUF_LEN];	/* line of source code being examined */
-	char fn_name1[BUF_LEN];	/* function name */
-	char fn_name2[BUF_LEN];	/* 2nd line of function name */
-
-	int i;			/* loops index */
-	int prg_loc = 0;	/* running loc count */
-	int fn_loc = 0;		/* lines of code in current function */
-	int fn_count = 0;	/* running function count */
-	int total_fn_loc = 0;	/* running function loc count */
+	struct name_list names;	/* source code files to count */
+	int arg;		/* argument index */
+	int n;			/* file index */
+	int status = 0;		/* exit status */
+	int over = 0;		/* files over budget */
+	int first = 1;		/* no file has been displayed yet */
+	struct file_data *file;	/* file checked against the budgets */
+	double start;		/* wall clock time when a file was started */
 
-	/* initial line and function states */
-	STATETYPE state = NewLine;
-	FNSTATETYPE fn_state = NotFunction;
-	strcpy(fn_name1, "");
-	strcpy(fn_name2, "");
+	memset(&names, 0, sizeof(names));
+	add_name(&opts.markers, "DO NOT EDIT");
+	add_name(&opts.markers, "generated by");
+	opts.minified_len = MINIFIED_LEN;
+	opts.seed = 1;
+	opts.prom_interval = 15;
 
 	if ( argc < 2 )
 	{
@@ -132,590 +157,6916 @@ int main(int argc, char *argv[])
 		exit(1);
 	}
 
-	if ( (strcmp(argv[1], "-h") == 0) || (strcmp(argv[1], "--help") == 0) )
+	for ( arg = 1; arg < argc && argv[arg][0] == '-'; arg++ )
 	{
-		 show_usage(argv[0]);
-		 exit(1);
+		if ( (strcmp(argv[arg], "-h") == 0) || (strcmp(argv[arg], "--help") == 0) )
+		{
+			 show_usage(argv[0]);
+			 exit(1);
+		}
+		else if ( strcmp(argv[arg], "--index") == 0 && arg + 1 < argc )
+			opts.index_file = argv[++arg];
+		else if ( strcmp(argv[arg], "--line-map") == 0 && arg + 1 < argc )
+			opts.line_map = argv[++arg];
+		else if ( (strcmp(argv[arg], "-p") == 0) || (strcmp(argv[arg], "--positions") == 0) )
+			opts.positions = 1;
+		else if ( strcmp(argv[arg], "-0") == 0 )
+			opts.null_names = 1;
+		else if ( strcmp(argv[arg], "--special") == 0 && arg + 1 < argc )
+		{
+			arg++;
+			if ( strcmp(argv[arg], "skip") == 0 )
+				opts.special = SpecialSkip;
+			else if ( strcmp(argv[arg], "quick") == 0 )
+				opts.special = SpecialQuick;
+			else if ( strcmp(argv[arg], "count") == 0 )
+				opts.special = SpecialCount;
+			else
+			{
+				fprintf(stderr, "Invalid --special policy %s\n", argv[arg]);
+				show_usage(argv[0]);
+				exit(1);
+			}
+		}
+		else if ( strcmp(argv[arg], "--marker") == 0 && arg + 1 < argc )
+			add_name(&opts.markers, argv[++arg]);
+		else if ( strcmp(argv[arg], "--minified") == 0 && arg + 1 < argc )
+			opts.minified_len = atoi(argv[++arg]);
+		else if ( strcmp(argv[arg], "--braces") == 0 )
+			opts.braces = 1;
+		else if ( strcmp(argv[arg], "--style") == 0 && arg + 1 < argc )
+		{
+			char *eq = strrchr(argv[++arg], '=');
+			STYLE style;
+
+			if ( !parse_style(eq != NULL ? eq + 1 : argv[arg], &style) )
+			{
+				fprintf(stderr, "Invalid --style %s\n", argv[arg]);
+				show_usage(argv[0]);
+				exit(1);
+			}
+			if ( eq != NULL )
+				add_style(&opts.styles, argv[arg], eq - argv[arg], style);
+			else
+				opts.style = style;
+		}
+		else if ( (strcmp(argv[arg], "-m") == 0) || (strcmp(argv[arg], "--metrics") == 0) )
+			opts.metrics = 1;
+		else if ( strcmp(argv[arg], "--dead-code") == 0 )
+			opts.dead_code = 1;
+		else if ( strncmp(argv[arg], "-U", 2) == 0 && (argv[arg][2] != '\0' || arg + 1 < argc) )
+		{
+			add_name(&opts.undefs, argv[arg][2] ? argv[arg] + 2 : argv[++arg]);
+			opts.dead_code = 1;
+		}
+		else if ( strncmp(argv[arg], "-I", 2) == 0 && (argv[arg][2] != '\0' || arg + 1 < argc) )
+			add_name(&opts.include_dirs, argv[arg][2] ? argv[arg] + 2 : argv[++arg]);
+		else if ( strcmp(argv[arg], "--tu") == 0 && arg + 1 < argc )
+		{
+			add_name(&names, argv[++arg]);
+			opts.tu = 1;
+		}
+		else if ( strcmp(argv[arg], "--max-fn-loc") == 0 && arg + 1 < argc )
+			opts.max_fn_loc = atoi(argv[++arg]);
+		else if ( strcmp(argv[arg], "--max-file-loc") == 0 && arg + 1 < argc )
+			opts.max_file_loc = atoi(argv[++arg]);
+		else if ( strcmp(argv[arg], "--fail-fast") == 0 )
+			opts.fail_fast = 1;
+		else if ( strcmp(argv[arg], "--shard") == 0 && arg + 1 < argc )
+		{
+			arg++;
+			if ( sscanf(argv[arg], "%d/%d", &opts.shard, &opts.shards) != 2
+			     || opts.shard < 1 || opts.shard > opts.shards )
+			{
+				fprintf(stderr, "Invalid --shard %s\n", argv[arg]);
+				show_usage(argv[0]);
+				exit(1);
+			}
+		}
+		else if ( strcmp(argv[arg], "--merge") == 0 )
+			opts.merge = 1;
+		else if ( strcmp(argv[arg], "--sample") == 0 && arg + 1 < argc )
+		{
+			arg++;
+			opts.sample = atof(argv[arg]);
+			if ( strchr(argv[arg], '%') != NULL )
+				opts.sample /= 100.0;
+			if ( opts.sample <= 0.0 || opts.sample > 1.0 )
+			{
+				fprintf(stderr, "Invalid --sample %s\n", argv[arg]);
+				show_usage(argv[0]);
+				exit(1);
+			}
+		}
+		else if ( strcmp(argv[arg], "--seed") == 0 && arg + 1 < argc )
+			opts.seed = (unsigned)atol(argv[++arg]);
+		else if ( strcmp(argv[arg], "--max-memory") == 0 && arg + 1 < argc )
+		{
+			arg++;
+			if ( (opts.max_memory = parse_size(argv[arg])) <= 0 )
+			{
+				fprintf(stderr, "Invalid --max-memory %s\n", argv[arg]);
+				show_usage(argv[0]);
+				exit(1);
+			}
+		}
+		else if ( strcmp(argv[arg], "--progress") == 0 )
+			opts.progress = 1;
+		else if ( strcmp(argv[arg], "--progress-fd") == 0 && arg + 1 < argc )
+			opts.progress_fd = atoi(argv[++arg]);
+		else if ( strcmp(argv[arg], "--prometheus") == 0 && arg + 1 < argc )
+			opts.prom_file = argv[++arg];
+		else if ( strcmp(argv[arg], "--prometheus-interval") == 0 && arg + 1 < argc )
+			opts.prom_interval = atoi(argv[++arg]);
+		else if ( strcmp(argv[arg], "--find") == 0 && arg + 2 < argc )
+			return find_in_index(argv[arg + 1], argv[arg + 2]) ? 0 : 1;
+		else if ( strcmp(argv[arg], "--over") == 0 && arg + 2 < argc )
+			return list_index_over(argv[arg + 1], atoi(argv[arg + 2])) ? 0 : 1;
+		else if ( strcmp(argv[arg], "--compare") == 0 && arg + 2 < argc )
+			return compare_results(argv[arg + 1], argv[arg + 2]);
+		else if ( strcmp(argv[arg], "--history") == 0 && arg + 1 < argc )
+			return count_history(argv[arg + 1]);
+		else if ( strcmp(argv[arg], "--stream") == 0 )
+			return count_stream();
+		else if ( strcmp(argv[arg], "--self-test") == 0 )
+			return self_test(arg + 1 < argc ? atoi(argv[arg + 1]) : 1000,
+					 arg + 2 < argc ? strtoul(argv[arg + 2], NULL, 10) : 1);
+		else
+		{
+			fprintf(stderr, "Invalid option %s\n", argv[arg]);
+			show_usage(argv[0]);
+			exit(1);
+		}
 	}
 
-	fp = fopen(argv[1], "r");
-	if ( fp == NULL )
+	for ( ; arg < argc; arg++ )
+		collect_names(&names, argv[arg]);
+	if ( opts.null_names )
+		read_null_names(&names);
+
+	if ( names.count == 0 )
 	{
-		fprintf(stderr, "Cannot open %s\n", argv[1]);
+		fprintf(stderr, "No source code file passed.\n");
 		show_usage(argv[0]);
 		exit(1);
 	}
+	if ( names.count > 1 && opts.line_map != NULL )
+	{
+		fprintf(stderr, "--line-map takes a single source code file.\n");
+		exit(1);
+	}
 
-	while ( !feof(fp) )
+	if ( opts.sample > 0.0 )
 	{
-		if ( fgets(buffer, BUF_LEN, fp) )
-		{
-			for ( i= 0; i < strlen(buffer); i++ )
-			{
-				switch (state)
-				{
-				case (NewLine) :
-					state = next_new_line(buffer[i]);
-					break;
-				case (NewLineNC) :
-					break;
-				case (PosComment) :
-					state = next_pos_comment(buffer[i]);
-					break;
-				case (CppComment) :
-					state = next_cpp_comment(buffer[i]);
-					breaFILE *fp;k;
-				case (Comment) :
-					state = next_comment(buffer[i]);
-					break;
-				case (PosEndComment) :
-					state = next_pos_end_comment(buffer[i]);
-					break;
-				case (EndComment) :
-					state = NewLineNC;
-					break;
-				case (CompDir) :
-					state = next_comp_dir(buffer[i]);
-					break;
-				case (LineOfCode) :
-					state = next_line_of_code(buffer[i]);
-					break;
-				case (OpenBracket) :
-					state = next_open_bracket(buffer[i]);
-					break;
-				case (CloseBracket1) :
-					state = next_close_bracket1(buffer[i]);
-					break;
-				case (CloseBracket2) :
-					state = next_close_bracket2(buffer[i]);
-					break;
-				case (PosEOL) :
-					state = next_pos_eol(buffer[i]);
-					break;
-				case (InlineComment) :
-					state = next_inline_comment(buffer[i]);
-					break;
-				}	/* end switch(state) */
-			}	/* end for loop */
+		status = sample_files(&names);
+		cleanup(&names);
+		return status;
+	}
 
-			if ( isalpha(buffer[0]) )
-			{
-				fn_state = PosFunction;
-				strcpy(fn_name1, buffer);
-				strcpy(fn_name2, "");
-				fn_loc = 0;
-			}
+	if ( opts.merge )
+	{
+		status = merge_results(&names);
+		cleanup(&names);
+		return status;
+	}
 
-			if ( fn_state == PosFunction )
+	if ( opts.tu )
+	{
+		status = count_units(&names);
+		cleanup(&names);
+		return status;
+	}
+
+	if ( opts.max_fn_loc > 0 || opts.max_file_loc > 0 )
+	{
+		for ( n = 0; n < names.count; n++ )
+		{
+			if ( !in_shard(names.names[n]) )
+				continue;
+			if ( !check_budget(names.names[n]) )
 			{
-				switch (buffer[0])
+				status = 1;
+				if ( opts.fail_fast )
 				{
-					case '{':
-						fn_state = IsFunction;
-						fn_count++;
-						break;
-					case ' ':
-					case '\t':
-						strcpy(fn_name2, buffer);
-						break;
-					case '}':
-						fn_state = NotFunction;
-						strcpy(fn_name1, "");
-						strcpy(fn_name2, "");
+					n++;
+					break;
 				}
 			}
+			check_memory();
+		}
+		over = spill.over;
+		for ( file = files; file != NULL; file = file->next )
+			over += file->over != WithinBudget;
+		printf("%d files checked, %d over budget\n", n, over);
+		cleanup(&names);
+		return status;
+	}
 
-			if ( state == NewLine )
-				prg_loc++;
-
-			if ( state == NewLine && fn_state == IsFunction )
+	start_progress(&names);
+	for ( n = 0; n < names.count; n++ )
+	{
+		if ( !in_shard(names.names[n]) )
+			continue;
+		start = wall_clock();
+		if ( !count_source(names.names[n], first) )
+		{
+			if ( names.count == 1 )
 			{
-				fn_loc++;
-				total_fn_loc++;
+				show_usage(argv[0]);
+				exit(1);
 			}
+			status = 1;
+			file_progress(names.names[n], NULL, wall_clock() - start);
+		}
+		else
+		{
+			last_file->seq = n;
+			file_progress(names.names[n], last_file, wall_clock() - start);
+			check_memory();
+		}
+		update_metrics(0);
+		first = 0;
+	}
+	show_progress(1);
+	update_metrics(1);
 
-			if ( state == NewLineNC )
-				state = NewLine;
+	if ( names.count > 1 )
+		print_totals();
 
-			if ( fn_state == IsFunction && buffer[0] == '}' )
-			{
-				insert_at_end(fn_name1, fn_name2, fn_loc);
-				fn_state = NotFunction;
-				strcpy(fn_name1, "");
-				strcpy(fn_name2, "");
-				fn_loc = 0;
-			}
-		}	/* end if( fgets(... */
-	}	/* end while (!feof(fp)) loop */
+	if ( opts.index_file != NULL )
+		write_index(opts.index_file);
 
-	/* Display output */
-	print_intro(argv[1]);
-	print_fn_data(argv[1], fn_count, prg_loc);
-	if ( fn_count != 0 )
-		print_summary(fn_count, total_fn_loc, prg_loc);
+	cleanup(&names);
+	return status;
+}
 
-	/* Clean up */
-	fclose(fp);
+/*
+ * FUNCTION
+ *	void cleanup(struct name_list *names)
+ * DESCRIPTION
+ *	Frees the lists, tables, option lists and spilled results of a run.
+ * PARAMETERS
+ *	struct name_list *names - the source code files of the run
+ * RETURN VALUE
+ *	None
+ */
+void cleanup(struct name_list *names)
+{
 	head = free_list(head);
+	files = free_files(files);
+	free_spill();
+	free_names(names);
+	free_names(&opts.markers);
+	free_names(&opts.undefs);
+	free_styles(&opts.styles);
+	free_names(&opts.include_dirs);
+	free_headers();
+	free_paths();
+}
 
-	return 0;
+/*
+ * FUNCTION
+ *	int count_source(char source[], int first)
+ * DESCRIPTION
+ *	Counts one source code file and displays its functions and summary.
+ *	Unless a function index is being written, the functions are freed
+ *	once they have been displayed.
+ * PARAMETERS
+ *	char source[] - name of the source code file
+ *	int first - non-zero for the first file of the run, which is preceded
+ *		    by the program introduction
+ * RETURN VALUE
+ *	1 if the file was counted, 0 if it could not be opened
+ */
+int count_source(char source[], int first)
+{
+	struct file_data *rec;	/* results for the source code file */
+	struct input in;	/* the source code file to count */
+	double start;		/* wall clock time at the start of a stage */
+
+	start = wall_clock();
+	if ( !open_source(&in, source) )
+		return 0;
+	rec = count_file(&in, source);
+	close_source(&in);
+	observe_stage(StageRead, in.read_time);
+	observe_stage(StageScan, wall_clock() - start - in.read_time);
+
+	start = wall_clock();
+	print_file(rec, first);
+	observe_stage(StageFormat, wall_clock() - start);
+	count_metrics(rec);
+
+	if ( opts.index_file == NULL )
+	{
+		head = free_list(head);
+		last = NULL;
+		rec->first_fn = NULL;
+	}
+
+	return 1;
 }
 
 /*
  * FUNCTION
- *	STATETYPE next_new_line(char ch)
+ *	void print_file(struct file_data *rec, int first)
  * DESCRIPTION
- *	Determines the next state if in NewLine state.
+ *	Displays the functions and summary of one source code file, or why
+ *	it was not counted in full.
  * PARAMETERS
- *	char ch - a character from the buffer containing the line of
- * 		  code being examined.
+ *	struct file_data *rec - the file, with its functions in the list
+ *	int first - non-zero for the first file of the run, which is preceded
+ *		    by the program introduction
  * RETURN VALUE
- *	Returns the new state.
- * SIDE EFFECTS
- *	None known
- * LIMITATIONS
- *	None known
+ *	None
  */
-STATETYPE next_new_line(char ch)
+void print_file(struct file_data *rec, int first)
 {
-	STATETYPE st;
-	if ( ch == '\n' )
-		st = NewLineNC;
-	else if ( isspace(ch) )
-		st = NewLine;
+	char *source = rec->file;
+
+	if ( first )
+		print_intro(source);
 	else
-		switch(ch)
+		print_title(source);
+	if ( rec->skipped )
+		printf("%s is a %s file and was not counted.\n\n", source,
+		       kind_name(rec->kind));
+	else if ( rec->kind != FileSource )
+	{
+		printf("%s is a %s file and was counted without functions.\n\n",
+		       source, kind_name(rec->kind));
+		printf("Total Program LOC:   %4d\n\n", rec->prg_loc);
+	}
+	else
+	{
+		print_fn_data(source, rec->first_fn, rec->fn_count, rec->prg_loc);
+		if ( rec->fn_count != 0 )
+			print_summary(rec->fn_count, rec->fn_loc, rec->prg_loc);
+	}
+	if ( opts.dead_code && !rec->skipped )
+		printf("Dead code lines:     %4d\n\n", rec->dead_loc);
+}
+
+/*
+ * FUNCTION
+ *	int in_shard(char name[])
+ * DESCRIPTION
+ *	Decides whether a source code file belongs to this run's --shard.
+ *	Files are assigned by an FNV-1a hash of the name as given, so every
+ *	machine given the same list of files agrees on the assignment.
+ * PARAMETERS
+ *	char name[] - name of the source code file
+ * RETURN VALUE
+ *	1 if the file is to be counted by this run, otherwise 0
+ */
+int in_shard(char name[])
+{
+	unsigned long h = 2166136261UL;
+	char *p;
+
+	if ( opts.shards == 0 )
+		return 1;
+	for ( p = name; *p; p++ )
+		h = ((h ^ (unsigned char)*p) * 16777619UL) & 0xffffffffUL;
+
+	return (int)(h % opts.shards) == opts.shard - 1;
+}
+
+/*
+ * FUNCTION
+ *	int merge_results(struct name_list *parts)
+ * DESCRIPTION
+ *	Combines the function indexes written by --shard runs and displays
+ *	the same report as a single run over all the files. Files are shown
+ *	in the order they were listed and their functions in the order they
+ *	appear in the file. With --index the combined index is written.
+ * PARAMETERS
+ *	struct name_list *parts - names of the function indexes to combine
+ * RETURN VALUE
+ *	0 on success, 1 if an index could not be read
+ */
+int merge_results(struct name_list *parts)
+{
+	struct idx_header hdr;
+	struct file_data **order;
+	struct file_data *file;
+	node **fns;
+	node *current;
+	FILE *ip;
+	int fn_count = 0;
+	int file_count = 0;
+	int n, i;
+
+	for ( n = 0; n < parts->count; n++ )
+	{
+		ip = open_index(parts->names[n], &hdr);
+		if ( ip == NULL )
+			return 1;
+		if ( !load_index(ip, &hdr, parts->names[n]) )
 		{
-			case '/':
-				st = PosComment;
-				break;
-			case '#':
-				st = CompDir;
-				break;
-			case '{':
-				st = OpenBracket;
-				break;
-			case '}':
-				st = CloseBracket1;
-				break;
-			default:
-				st = LineOfCode;
-				break;
-	   	}
+			fclose(ip);
+			return 1;
+		}
+		fclose(ip);
+	}
 
-	return st;
+	for ( current = head; current != NULL; current = current->next )
+		fn_count++;
+	for ( file = files; file != NULL; file = file->next )
+		file_count++;
+	fns = calloc(fn_count ? fn_count : 1, sizeof(node *));
+	order = calloc(file_count ? file_count : 1, sizeof(struct file_data *));
+	if ( fns == NULL || order == NULL )
+	{
+		fprintf(stderr, "Out of space\n");
+		exit(1);
+	}
+
+	/* relink the functions by file and line */
+	for ( n = 0, current = head; current != NULL; current = current->next )
+		fns[n++] = current;
+	qsort(fns, fn_count, sizeof(node *), compare_fn_file);
+	for ( n = 0; n < fn_count; n++ )
+		fns[n]->next = n + 1 < fn_count ? fns[n + 1] : NULL;
+	head = fn_count ? fns[0] : NULL;
+	last = fn_count ? fns[fn_count - 1] : NULL;
+
+	/* find the first function of each file */
+	for ( n = 0, file = files; file != NULL; file = file->next )
+		order[n++] = file;
+	qsort(order, file_count, sizeof(struct file_data *), compare_file_name);
+	for ( n = 0, i = 0; n < file_count; n++ )
+	{
+		while ( i < fn_count && strcmp(fns[i]->file, order[n]->file) < 0 )
+			i++;
+		if ( i < fn_count && strcmp(fns[i]->file, order[n]->file) == 0 )
+			order[n]->first_fn = fns[i];
+	}
+
+	/* relink the files in the order they were listed */
+	qsort(order, file_count, sizeof(struct file_data *), compare_file_seq);
+	for ( n = 0; n < file_count; n++ )
+		order[n]->next = n + 1 < file_count ? order[n + 1] : NULL;
+	files = file_count ? order[0] : NULL;
+	last_file = file_count ? order[file_count - 1] : NULL;
+
+	for ( n = 0; n < file_count; n++ )
+		print_file(order[n], n == 0);
+	if ( file_count > 1 )
+		print_totals();
+
+	if ( opts.index_file != NULL )
+		write_index(opts.index_file);
+
+	free(fns);
+	free(order);
+	head = free_list(head);
+	files = free_files(files);
+
+	return 0;
+}
+
+/*
+ * FUNCTION
+ *	int compare_fn_file(const void *a, const void *b)
+ * DESCRIPTION
+ *	qsort() comparison of two functions by file name, then starting line.
+ * PARAMETERS
+ *	const void *a, const void *b - pointers to the node pointers compared
+ * RETURN VALUE
+ *	Less than, equal to or greater than zero as a sorts before, with or
+ *	after b
+ */
+int compare_fn_file(const void *a, const void *b)
+{
+	const node *fa = *(node * const *)a;
+	const node *fb = *(node * const *)b;
+	int cmp;
+
+	cmp = strcmp(fa->file, fb->file);
+	if ( cmp == 0 )
+		cmp = fa->pos.start_line - fb->pos.start_line;
+	return cmp;
+}
+
+/*
+ * FUNCTION
+ *	int compare_file_name(const void *a, const void *b)
+ * DESCRIPTION
+ *	qsort() comparison of two files by name.
+ * PARAMETERS
+ *	const void *a, const void *b - pointers to the file pointers compared
+ * RETURN VALUE
+ *	Less than, equal to or greater than zero as a sorts before, with or
+ *	after b
+ */
+int compare_file_name(const void *a, const void *b)
+{
+	return strcmp((*(struct file_data * const *)a)->file,
+		      (*(struct file_data * const *)b)->file);
+}
+
+/*
+ * FUNCTION
+ *	int compare_file_seq(const void *a, const void *b)
+ * DESCRIPTION
+ *	qsort() comparison of two files by their position in the list counted.
+ * PARAMETERS
+ *	const void *a, const void *b - pointers to the file pointers compared
+ * RETURN VALUE
+ *	Less than, equal to or greater than zero as a sorts before, with or
+ *	after b
+ */
+int compare_file_seq(const void *a, const void *b)
+{
+	return (*(struct file_data * const *)a)->seq
+	       - (*(struct file_data * const *)b)->seq;
+}
+
+/*
+ * FUNCTION
+ *	int sample_files(struct name_list *names)
+ * DESCRIPTION
+ *	Counts a random sample of opts.sample of the files in each directory
+ *	(at least one file per directory) and estimates the totals of all
+ *	the files, with 95% confidence intervals, from the stratified sample.
+ *	The same seed always picks the same files. With --shard only the
+ *	files of this shard are sampled and estimated.
+ * PARAMETERS
+ *	struct name_list *names - the files to sample
+ * RETURN VALUE
+ *	0 on success, 1 if a sampled file could not be opened
+ */
+int sample_files(struct name_list *names)
+{
+	struct sample_item *items;
+	struct sample_sum sums[3];	/* functions, function LOC, program LOC */
+	struct file_data *rec;
+	struct input in;
+	double *x[3];		/* measures of the files sampled in a stratum */
+	int count = 0;
+	int sampled = 0, strata = 0, status = 0;
+	int start, end, m, k, j, n;
+	unsigned long seed = opts.seed;
+	char *name;
+
+	items = calloc(names->count ? names->count : 1, sizeof(struct sample_item));
+	for ( n = 0; n < 3; n++ )
+		x[n] = calloc(names->count ? names->count : 1, sizeof(double));
+	if ( items == NULL || x[0] == NULL || x[1] == NULL || x[2] == NULL )
+	{
+		fprintf(stderr, "Out of space\n");
+		exit(1);
+	}
+	memset(sums, 0, sizeof(sums));
+
+	/* group the files of this shard by directory */
+	for ( n = 0; n < names->count; n++ )
+	{
+		name = names->names[n];
+		if ( !in_shard(name) )
+			continue;
+		items[count].name = name;
+		for ( k = 0; name[k] != '\0'; k++ )
+			if ( name[k] == '/' || name[k] == '\\' )
+				items[count].dir_len = k + 1;
+		count++;
+	}
+	qsort(items, count, sizeof(struct sample_item), compare_sample_dir);
+
+	for ( start = 0; start < count; start = end )
+	{
+		for ( end = start + 1; end < count
+		      && items[end].dir_len == items[start].dir_len
+		      && strncmp(items[end].name, items[start].name, items[start].dir_len) == 0; end++ )
+			;
+		m = (int)(opts.sample * (end - start) + 0.5);
+		if ( m < 1 )
+			m = 1;
+
+		/* pick m files with a partial shuffle */
+		for ( k = 0; k < m; k++ )
+		{
+			struct sample_item tmp;
+
+			j = start + k + (int)(next_random(&seed) / 4294967296.0
+					      * (end - start - k));
+			tmp = items[start + k];
+			items[start + k] = items[j];
+			items[j] = tmp;
+
+			name = items[start + k].name;
+			if ( !open_source(&in, name) )
+			{
+				x[0][k] = x[1][k] = x[2][k] = 0.0;
+				status = 1;
+				continue;
+			}
+			rec = count_file(&in, name);
+			close_source(&in);
+			x[0][k] = rec->fn_count;
+			x[1][k] = rec->fn_loc;
+			x[2][k] = rec->prg_loc;
+			head = free_list(head);
+			last = NULL;
+			files = free_files(files);
+			last_file = NULL;
+		}
+
+		for ( n = 0; n < 3; n++ )
+			add_stratum(&sums[n], x[n], m, end - start);
+		sampled += m;
+		strata++;
+	}
+
+	print_banner();
+	printf("Sampled %d of %d files from %d directories (seed %u)\n\n",
+	       sampled, count, strata, opts.seed);
+	printf("Estimated totals and 95%% confidence intervals:\n");
+	print_estimate("Number of functions:", &sums[0]);
+	print_estimate("Function LOC:", &sums[1]);
+	print_estimate("Total Program LOC:", &sums[2]);
+	printf("\n");
+
+	for ( n = 0; n < 3; n++ )
+		free(x[n]);
+	free(items);
+
+	return status;
+}
+
+/*
+ * FUNCTION
+ *	int compare_sample_dir(const void *a, const void *b)
+ * DESCRIPTION
+ *	qsort() comparison of two files by directory, then name.
+ * PARAMETERS
+ *	const void *a, const void *b - pointers to the sample_items compared
+ * RETURN VALUE
+ *	Less than, equal to or greater than zero as a sorts before, with or
+ *	after b
+ */
+int compare_sample_dir(const void *a, const void *b)
+{
+	const struct sample_item *ia = a;
+	const struct sample_item *ib = b;
+	int len = ia->dir_len < ib->dir_len ? ia->dir_len : ib->dir_len;
+	int cmp;
+
+	cmp = strncmp(ia->name, ib->name, len);
+	if ( cmp == 0 )
+		cmp = ia->dir_len - ib->dir_len;
+	if ( cmp == 0 )
+		cmp = strcmp(ia->name, ib->name);
+	return cmp;
+}
+
+/*
+ * FUNCTION
+ *	void add_stratum(struct sample_sum *sum, double x[], int m, int n)
+ * DESCRIPTION
+ *	Adds the estimate of one directory to the estimated total of a
+ *	measure: n times the sample mean, with the variance of that estimate
+ *	corrected for sampling without replacement. A directory with a single
+ *	file sampled from several has no variance of its own and is given a
+ *	coefficient of variation of 1.
+ * PARAMETERS
+ *	struct sample_sum *sum - the running estimate
+ *	double x[] - the measure for each file sampled
+ *	int m - number of files sampled
+ *	int n - number of files in the directory
+ * RETURN VALUE
+ *	None
+ */
+void add_stratum(struct sample_sum *sum, double x[], int m, int n)
+{
+	double total = 0.0, sq = 0.0, mean, s2;
+	int k;
+
+	for ( k = 0; k < m; k++ )
+	{
+		total += x[k];
+		sq += x[k] * x[k];
+	}
+	mean = total / m;
+	if ( m > 1 )
+		s2 = (sq - total * mean) / (m - 1);
+	else
+		s2 = mean * mean;
+
+	sum->seen += total;
+	sum->total += n * mean;
+	sum->var += (double)n * n * (1.0 - (double)m / n) * s2 / m;
+}
+
+/*
+ * FUNCTION
+ *	void print_estimate(char label[], struct sample_sum *sum)
+ * DESCRIPTION
+ *	displays an estimated total with its 95% confidence interval. The
+ *	interval never goes below the total of the files actually counted.
+ * PARAMETERS
+ *	char label[] - name of the measure
+ *	struct sample_sum *sum - the estimate
+ * RETURN VALUE
+ *	None
+ */
+void print_estimate(char label[], struct sample_sum *sum)
+{
+	double half = 1.96 * sqrt(sum->var);
+	double low = sum->total - half;
+
+	if ( low < sum->seen )
+		low = sum->seen;
+	printf("%-21s%8.0f  (%.0f - %.0f)\n", label, sum->total, low,
+	       sum->total + half);
+}
+
+/*
+ * FUNCTION
+ *	int check_budget(char source[])
+ * DESCRIPTION
+ *	Counts one source code file against the --max-fn-loc and
+ *	--max-file-loc budgets. Counting stops as soon as a budget is
+ *	exceeded and only the function or file over budget is displayed;
+ *	nothing is displayed for a file within budget.
+ * PARAMETERS
+ *	char source[] - name of the source code file
+ * RETURN VALUE
+ *	1 if the file is within budget, 0 if it is over or could not be opened
+ */
+int check_budget(char source[])
+{
+	struct file_data *rec;	/* results for the source code file */
+	struct input in;	/* the source code file to count */
+
+	if ( !open_source(&in, source) )
+		return 0;
+	rec = count_file(&in, source);
+	close_source(&in);
+
+	if ( rec->over == OverFunction )
+		printf("%s:%d: function over %d LOC\t%s", source, rec->over_line,
+		       opts.max_fn_loc, rec->over_fn->name1);
+	else if ( rec->over == OverFile )
+		printf("%s:%d: file over %d LOC\n", source, rec->over_line,
+		       opts.max_file_loc);
+
+	head = free_list(head);
+	last = NULL;
+	rec->first_fn = NULL;
+	rec->over_fn = NULL;
+
+	return rec->over == WithinBudget;
+}
+
+/*
+ * FUNCTION
+ *	FILEKIND prescan(struct input *in)
+ * DESCRIPTION
+ *	Classifies a source code file from its first block. A file holding a
+ *	zero byte is binary, a file holding one of the generated file markers
+ *	(compared without regard to case) is generated, and a file whose
+ *	lines average more than opts.minified_len characters is minified.
+ *	UTF-16 is checked after its first block has been transcoded, so its
+ *	zero bytes do not make it binary.
+ * PARAMETERS
+ *	struct input *in - the source code, its first block read by
+ *			   detect_encoding()
+ * RETURN VALUE
+ *	The kind of file
+ */
+FILEKIND prescan(struct input *in)
+{
+	char *data;
+	long len;
+	long lines = 0;
+	long n;
+
+	/* detect_encoding() leaves UTF-16 to be transcoded by input_eof() */
+	if ( input_eof(in) )
+		return FileSource;
+	data = in->data + in->pos;
+	len = in->size - in->pos;
+	if ( memchr(data, '\0', len) != NULL )
+		return FileBinary;
+
+	for ( n = 0; n < opts.markers.count; n++ )
+		if ( has_marker(data, len, opts.markers.names[n]) )
+			return FileGenerated;
+
+	for ( n = 0; n < len; n++ )
+		if ( data[n] == '\n' )
+			lines++;
+	if ( len > (lines + 1) * opts.minified_len )
+		return FileMinified;
+
+	return FileSource;
+}
+
+/*
+ * FUNCTION
+ *	int has_marker(char data[], long len, char marker[])
+ * DESCRIPTION
+ *	Searches a block of text for a marker without regard to case.
+ * PARAMETERS
+ *	char data[] - the text to search, not NUL terminated
+ *	long len - length of the text
+ *	char marker[] - the marker
+ * RETURN VALUE
+ *	1 if the marker was found, otherwise 0
+ */
+int has_marker(char data[], long len, char marker[])
+{
+	long mlen = strlen(marker);
+	long n, k;
+
+	for ( n = 0; n + mlen <= len; n++ )
+	{
+		for ( k = 0; k < mlen; k++ )
+			if ( tolower((unsigned char)data[n + k]) != tolower((unsigned char)marker[k]) )
+				break;
+		if ( k == mlen )
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * FUNCTION
+ *	char *kind_name(FILEKIND kind)
+ * DESCRIPTION
+ *	Returns the name of a kind of file for display.
+ * PARAMETERS
+ *	FILEKIND kind - the kind of file
+ * RETURN VALUE
+ *	The name of the kind
+ */
+char *kind_name(FILEKIND kind)
+{
+	switch (kind)
+	{
+		case FileBinary:
+			return "binary";
+		case FileGenerated:
+			return "generated";
+		case FileMinified:
+			return "minified";
+		default:
+			return "source code";
+	}
+}
+
+/*
+ * FUNCTION
+ *	int parse_style(char name[], STYLE *style)
+ * DESCRIPTION
+ *	Looks up a coding style by name: kr, allman or gnu. linux is
+ *	accepted for kr, as the kernel places its braces the same way.
+ * PARAMETERS
+ *	char name[] - name of the style
+ *	STYLE *style - receives the style
+ * RETURN VALUE
+ *	1 if the name is a style, otherwise 0
+ */
+int parse_style(char name[], STYLE *style)
+{
+	if ( strcmp(name, "kr") == 0 )
+		*style = StyleKR;
+	else if ( strcmp(name, "allman") == 0 )
+		*style = StyleAllman;
+	else if ( strcmp(name, "gnu") == 0 )
+		*style = StyleGnu;
+	else if ( strcmp(name, "linux") == 0 )
+		*style = StyleKR;
+	else
+		return 0;
+	return 1;
+}
+
+/*
+ * FUNCTION
+ *	STYLE style_for(char source[])
+ * DESCRIPTION
+ *	Chooses the coding style of a source code file: the style of the
+ *	first --style pattern=style whose pattern matches the file name, or
+ *	else the default style.
+ * PARAMETERS
+ *	char source[] - name of the source code file
+ * RETURN VALUE
+ *	The coding style
+ */
+STYLE style_for(char source[])
+{
+	int n;
+
+	for ( n = 0; n < opts.styles.count; n++ )
+		if ( match_pattern(opts.styles.rules[n].pattern, source) )
+			return opts.styles.rules[n].style;
+	return opts.style;
+}
+
+/*
+ * FUNCTION
+ *	void add_style(struct style_list *list, char pattern[], int len,
+ *		       STYLE style)
+ * DESCRIPTION
+ *	Adds a --style pattern=style option to the list, keeping a copy of
+ *	the pattern on its own so files are matched without parsing the
+ *	option again.
+ * PARAMETERS
+ *	struct style_list *list - the list
+ *	char pattern[] - the pattern, followed by the rest of the option
+ *	int len - length of the pattern
+ *	STYLE style - the style of the files matching the pattern
+ * RETURN VALUE
+ *	None, exits if out of memory
+ */
+void add_style(struct style_list *list, char pattern[], int len, STYLE style)
+{
+	struct style_rule *rule;
+
+	if ( list->count == list->size )
+	{
+		list->size = list->size ? list->size * 2 : 16;
+		list->rules = realloc(list->rules, list->size * sizeof(struct style_rule));
+		if ( list->rules == NULL )
+		{
+			fprintf(stderr, "Out of space\n");
+			exit(1);
+		}
+	}
+
+	rule = &list->rules[list->count++];
+	rule->pattern = malloc(len + 1);
+	if ( rule->pattern == NULL )
+	{
+		fprintf(stderr, "Out of space\n");
+		exit(1);
+	}
+	memcpy(rule->pattern, pattern, len);
+	rule->pattern[len] = '\0';
+	rule->style = style;
+}
+
+/*
+ * FUNCTION
+ *	void free_styles(struct style_list *list)
+ * DESCRIPTION
+ *	frees the memory allocated for a list of --style options
+ * PARAMETERS
+ *	struct style_list *list - the list
+ * RETURN VALUE
+ *	None
+ */
+void free_styles(struct style_list *list)
+{
+	int n;
+
+	for ( n = 0; n < list->count; n++ )
+		free(list->rules[n].pattern);
+	free(list->rules);
+	memset(list, 0, sizeof(*list));
+}
+
+/*
+ * FUNCTION
+ *	int match_pattern(char pattern[], char name[])
+ * DESCRIPTION
+ *	Matches a file name against a pattern in which '*' stands for any
+ *	characters, including '/', and '?' for any one character. '/' and
+ *	'\\' match each other.
+ * PARAMETERS
+ *	char pattern[] - the pattern
+ *	char name[] - the file name
+ * RETURN VALUE
+ *	1 if the name matches, otherwise 0
+ */
+int match_pattern(char pattern[], char name[])
+{
+	char *star = NULL;	/* last '*' in the pattern */
+	char *retry = NULL;	/* where the last '*' match resumes */
+
+	while ( *name != '\0' )
+	{
+		if ( *pattern == '*' )
+		{
+			star = pattern++;
+			retry = name;
+		}
+		else if ( *pattern == '?' || *pattern == *name
+			  || ((*pattern == '/' || *pattern == '\\')
+			      && (*name == '/' || *name == '\\')) )
+		{
+			pattern++;
+			name++;
+		}
+		else if ( star != NULL )
+		{
+			pattern = star + 1;
+			name = ++retry;
+		}
+		else
+			return 0;
+	}
+	while ( *pattern == '*' )
+		pattern++;
+	return *pattern == '\0';
+}
+
+/*
+ * FUNCTION
+ *	void scan_scope(struct scope_state *sc, char ch)
+ * DESCRIPTION
+ *	Follows one character of source code for --braces: skips comments,
+ *	literals and preprocessor lines, collects the text of a possible
+ *	function header and opens and closes scopes at braces.
+ * PARAMETERS
+ *	struct scope_state *sc - the open braces and the header so far
+ *	char ch - the next character of the source code
+ * RETURN VALUE
+ *	None
+ */
+void scan_scope(struct scope_state *sc, char ch)
+{
+	char prev = sc->prev;
+
+	sc->prev = ch;
+	switch (sc->lex)
+	{
+	case LexBlockComment:
+		if ( prev == '*' && ch == '/' )
+		{
+			sc->lex = LexCode;
+			sc->prev = ' ';
+		}
+		return;
+	case LexString:
+	case LexChar:
+		add_header(sc, ch);
+		if ( prev == '\\' && ch == '\\' )
+			sc->prev = ' ';		/* an escaped backslash */
+		else if ( (ch == '"' && sc->lex == LexString && prev != '\\')
+			  || (ch == '\'' && sc->lex == LexChar && prev != '\\')
+			  || (ch == '\n' && prev != '\\') )
+			sc->lex = LexCode;
+		return;
+	case LexLineComment:
+	case LexDirective:
+		if ( ch == '\n' && prev != '\\' )
+		{
+			sc->lex = LexCode;
+			sc->blank_line = 1;
+			add_header(sc, ch);
+		}
+		return;
+	case LexCode:
+		break;
+	}
+
+	/* keywords and operators for the complexity of functions */
+	if ( isalnum((unsigned char)ch) || ch == '_' )
+	{
+		if ( sc->word_len < (int)sizeof(sc->word) - 1 )
+			sc->word[sc->word_len] = ch;
+		sc->word_len++;
+	}
+	else
+	{
+		if ( sc->word_len > 0 )
+			end_word(sc);
+		if ( (ch == '&' || ch == '|') && prev == ch )
+		{
+			sc->metrics.branches++;
+			sc->prev = ' ';
+		}
+	}
+
+	if ( ch == '\n' )
+	{
+		sc->blank_line = 1;
+		add_header(sc, ch);
+		return;
+	}
+	if ( ch == '#' && sc->blank_line )
+	{
+		sc->lex = LexDirective;
+		return;
+	}
+	if ( ch != ' ' && ch != '\t' )
+		sc->blank_line = 0;
+
+	switch (ch)
+	{
+	case '/':
+		if ( prev == '/' )
+		{
+			sc->header_len -= sc->header_len > 0;
+			sc->lex = LexLineComment;
+			return;
+		}
+		break;
+	case '*':
+		if ( prev == '/' )
+		{
+			sc->header_len -= sc->header_len > 0;
+			sc->lex = LexBlockComment;
+			sc->prev = ' ';
+			add_header(sc, ' ');
+			return;
+		}
+		break;
+	case '"':
+		sc->lex = LexString;
+		break;
+	case '\'':
+		if ( !isalnum((unsigned char)prev) )	/* not 1'000 */
+			sc->lex = LexChar;
+		break;
+	case '{':
+		open_scope(sc);
+		return;
+	case '}':
+		close_scope(sc);
+		return;
+	case ';':
+		sc->header_len = 0;
+		return;
+	case ':':
+		/* an access specifier ends the header like ';' */
+		sc->header[sc->header_len] = '\0';
+		if ( prev != ':' && (is_word(sc->header, sc->header, "public")
+		     || is_word(sc->header, sc->header, "private")
+		     || is_word(sc->header, sc->header, "protected")) )
+		{
+			sc->header_len = 0;
+			return;
+		}
+		break;
+	}
+	add_header(sc, ch);
+}
+
+/*
+ * FUNCTION
+ *	void add_header(struct scope_state *sc, char ch)
+ * DESCRIPTION
+ *	Adds a character to the possible function header, unless the header
+ *	is inside a function or other braces where it is not needed. Leading
+ *	blanks are dropped and the line where the header starts is recorded.
+ * PARAMETERS
+ *	struct scope_state *sc - the open braces and the header so far
+ *	char ch - the character
+ * RETURN VALUE
+ *	None
+ */
+void add_header(struct scope_state *sc, char ch)
+{
+	if ( sc->depth > 0 && (sc->depth >= MAX_SCOPE
+	     || sc->kind[sc->depth] != ScopeContainer) )
+		return;
+	if ( sc->header_len == 0 )
+	{
+		if ( ch == ' ' || ch == '\t' || ch == '\n' )
+			return;
+		sc->header_line = sc->line_no;
+		sc->header_offset = sc->line_offset;
+	}
+	if ( sc->header_len < HEADER_LEN - 1 )
+		sc->header[sc->header_len++] = ch;
+}
+
+/*
+ * FUNCTION
+ *	void end_word(struct scope_state *sc)
+ * DESCRIPTION
+ *	Counts the identifier just read if it is a branch keyword or return.
+ * PARAMETERS
+ *	struct scope_state *sc - the identifier and the complexity so far
+ * RETURN VALUE
+ *	None
+ */
+void end_word(struct scope_state *sc)
+{
+	if ( sc->word_len < (int)sizeof(sc->word) )
+	{
+		sc->word[sc->word_len] = '\0';
+		if ( strcmp(sc->word, "if") == 0 || strcmp(sc->word, "for") == 0
+		     || strcmp(sc->word, "while") == 0 || strcmp(sc->word, "case") == 0 )
+			sc->metrics.branches++;
+		else if ( strcmp(sc->word, "return") == 0 )
+			sc->metrics.returns++;
+	}
+	sc->word_len = 0;
+}
+
+/*
+ * FUNCTION
+ *	void open_scope(struct scope_state *sc)
+ * DESCRIPTION
+ *	Opens a brace. At the top level or in a namespace, class or extern
+ *	"C" block the header decides what the brace belongs to; an opening
+ *	function brace starts counting the function.
+ * PARAMETERS
+ *	struct scope_state *sc - the open braces and the header so far
+ * RETURN VALUE
+ *	None
+ */
+void open_scope(struct scope_state *sc)
+{
+	SCOPEKIND kind = ScopeOther;
+
+	if ( sc->depth == 0 || (sc->depth < MAX_SCOPE
+	     && sc->kind[sc->depth] == ScopeContainer) )
+	{
+		sc->header[sc->header_len] = '\0';
+		kind = classify_header(sc->header);
+	}
+
+	sc->depth++;
+	if ( sc->depth < MAX_SCOPE )
+		sc->kind[sc->depth] = kind;
+	else
+		kind = ScopeOther;
+	if ( sc->depth - sc->base_depth > sc->metrics.depth )
+		sc->metrics.depth = sc->depth - sc->base_depth;
+
+	if ( kind == ScopeFunction )
+	{
+		split_header(sc->header, sc->open_fn.name1, sc->open_fn.name2);
+		sc->open_fn.pos.start_line = sc->header_line;
+		sc->open_fn.pos.start_offset = sc->header_offset;
+		sc->open_fn.loc = 0;
+		sc->fn_depth = sc->depth;
+		sc->base_depth = sc->depth;
+		memset(&sc->metrics, 0, sizeof(sc->metrics));
+		sc->touched = 1;
+	}
+	sc->header_len = 0;
+}
+
+/*
+ * FUNCTION
+ *	void close_scope(struct scope_state *sc)
+ * DESCRIPTION
+ *	Closes a brace. Closing a function brace moves the function to the
+ *	functions closed in the current chunk, which count_file() adds to
+ *	the list once the LOC of the chunk is known.
+ * PARAMETERS
+ *	struct scope_state *sc - the open braces
+ * RETURN VALUE
+ *	None
+ */
+void close_scope(struct scope_state *sc)
+{
+	sc->header_len = 0;
+	if ( sc->depth == 0 )
+		return;		/* unbalanced, e.g. braces split by #if */
+
+	if ( sc->depth == sc->fn_depth )
+	{
+		sc->fn_depth = 0;
+		if ( sc->closed_count < MAX_CLOSED )
+		{
+			sc->open_fn.pos.end_line = sc->line_no;
+			sc->open_fn.pos.end_offset = sc->end_offset;
+			sc->open_fn.metrics = sc->metrics;
+			sc->closed[sc->closed_count++] = sc->open_fn;
+		}
+	}
+	sc->depth--;
+}
+
+/*
+ * FUNCTION
+ *	SCOPEKIND classify_header(char header[])
+ * DESCRIPTION
+ *	Decides what an opening brace belongs to from the text before it. A
+ *	namespace, extern "C", class, struct or union holds functions; a
+ *	header with a parameter list and no '=' outside parentheses is a
+ *	function; anything else, such as an enum or an initializer, is not.
+ * PARAMETERS
+ *	char header[] - the text since the last ';', '{' or '}'
+ * RETURN VALUE
+ *	The kind of scope the brace opens
+ */
+SCOPEKIND classify_header(char header[])
+{
+	SCOPEKIND word_kind = ScopeOther;
+	int paren = 0;
+	int params = 0;
+	int has_word = 0;
+	char *p = header;
+	char *q;
+
+	if ( is_word(header, p, "namespace") )
+		return ScopeContainer;
+	if ( is_word(header, p, "extern") )
+	{
+		q = p + 6 + strspn(p + 6, " \t\n");
+		if ( *q == '"' )
+			return ScopeContainer;
+	}
+
+	for ( q = p; *q; q++ )
+	{
+		if ( *q == '(' )
+		{
+			params = 1;
+			paren++;
+		}
+		else if ( *q == ')' )
+			paren--;
+		else if ( paren == 0 && *q == '=' )
+		{
+			char *b = q;
+
+			while ( b > p && (b[-1] == ' ' || b[-1] == '\t') )
+				b--;
+			if ( b - p < 8 || strncmp(b - 8, "operator", 8) != 0 )
+				if ( q == p || (q[-1] != '=' && strchr("!<>+-*/%&|^", q[-1]) == NULL) )
+					return ScopeOther;
+		}
+		else if ( paren == 0 && !params && !has_word )
+		{
+			if ( is_word(header, q, "class") || is_word(header, q, "struct")
+			     || is_word(header, q, "union") )
+			{
+				word_kind = ScopeContainer;
+				has_word = 1;
+			}
+			else if ( is_word(header, q, "enum") )
+				has_word = 1;
+		}
+	}
+
+	if ( params )
+		return ScopeFunction;
+	return word_kind;
+}
+
+/*
+ * FUNCTION
+ *	int is_word(char text[], char *at, char word[])
+ * DESCRIPTION
+ *	Tests whether a keyword appears as a whole word at a place in a text.
+ * PARAMETERS
+ *	char text[] - the text
+ *	char *at - the place in the text
+ *	char word[] - the keyword
+ * RETURN VALUE
+ *	1 if the keyword is there, otherwise 0
+ */
+int is_word(char text[], char *at, char word[])
+{
+	size_t len = strlen(word);
+
+	if ( at > text && (isalnum((unsigned char)at[-1]) || at[-1] == '_') )
+		return 0;
+	return strncmp(at, word, len) == 0 && !isalnum((unsigned char)at[len])
+	       && at[len] != '_';
+}
+
+/*
+ * FUNCTION
+ *	void split_header(char header[], char name1[], char name2[])
+ * DESCRIPTION
+ *	Splits the text of a function header into the two lines shown for a
+ *	function: its first line, and the rest joined into a second line.
+ *	Trailing blanks are removed and each line ends in a newline.
+ * PARAMETERS
+ *	char header[] - the text of the header
+ *	char name1[] - receives the first line, BUF_LEN characters
+ *	char name2[] - receives the second line, or ""
+ * RETURN VALUE
+ *	None
+ */
+void split_header(char header[], char name1[], char name2[])
+{
+	size_t len = strlen(header);
+	size_t first, n = 0;
+	char *rest;
+
+	while ( len > 0 && strchr(" \t\n", header[len - 1]) != NULL )
+		len--;
+	first = strcspn(header, "\n");
+	if ( first > len )
+		first = len;
+	if ( first > BUF_LEN - 2 )
+		first = BUF_LEN - 2;
+	memcpy(name1, header, first);
+	strcpy(name1 + first, "\n");
+
+	name2[0] = '\0';
+	rest = header + strcspn(header, "\n");
+	if ( rest >= header + len )
+		return;
+	name2[n++] = '\t';
+	for ( rest += strspn(rest, " \t\n"); rest < header + len && n < BUF_LEN - 2; rest++ )
+		if ( *rest == '\n' )
+			name2[n++] = ' ';
+		else if ( !(*rest == ' ' || *rest == '\t') || name2[n - 1] != ' ' )
+			name2[n++] = *rest;
+	strcpy(name2 + n, "\n");
+}
+
+/*
+ * FUNCTION
+ *	int dead_region(char line[], struct pp_state *pp)
+ * DESCRIPTION
+ *	Follows the preprocessor conditionals to find the lines disabled by
+ *	#if 0, or by a condition on a macro named with -U, up to the matching
+ *	#else, #elif or #endif. A conditional whose condition cannot be
+ *	evaluated is taken to be live. The directives that open and close a
+ *	disabled region are themselves live.
+ * PARAMETERS
+ *	char line[] - the start of a physical line that starts in NewLine
+ *	struct pp_state *pp - the conditionals seen so far in the file
+ * RETURN VALUE
+ *	1 if the line is dead code, otherwise 0
+ */
+int dead_region(char line[], struct pp_state *pp)
+{
+	int was_dead = pp->dead_depth != 0;
+	char *p = line + strspn(line, " \t");
+	char *word;
+	int len;
+	int cond;
+
+	if ( *p != '#' )
+		return was_dead;
+	p += 1 + strspn(p + 1, " \t");
+	word = p;
+	while ( isalpha((unsigned char)*p) )
+		p++;
+	len = p - word;
+	p += strspn(p, " \t");
+
+	if ( (len == 2 && strncmp(word, "if", 2) == 0)
+	     || (len == 5 && strncmp(word, "ifdef", 5) == 0)
+	     || (len == 6 && strncmp(word, "ifndef", 6) == 0) )
+	{
+		pp->depth++;
+		if ( was_dead || pp->depth > MAX_NEST )
+			return was_dead;
+
+		if ( len == 2 )
+			cond = eval_condition(p);
+		else if ( is_undef(p, strcspn(p, " \t\r\n/")) )
+			cond = len == 6;
+		else
+			cond = 2;
+
+		pp->taken[pp->depth] = cond;
+		if ( cond == 0 )
+			pp->dead_depth = pp->depth;
+	}
+	else if ( len == 4 && strncmp(word, "elif", 4) == 0 )
+	{
+		if ( pp->depth > MAX_NEST || (pp->dead_depth && pp->dead_depth < pp->depth) )
+			return was_dead;
+		if ( pp->taken[pp->depth] == 1 )
+			pp->dead_depth = pp->depth;
+		else
+		{
+			cond = eval_condition(p);
+			pp->dead_depth = cond == 0 ? pp->depth : 0;
+			if ( cond != 0 )
+				pp->taken[pp->depth] = cond;
+		}
+	}
+	else if ( len == 4 && strncmp(word, "else", 4) == 0 )
+	{
+		if ( pp->depth > MAX_NEST || (pp->dead_depth && pp->dead_depth < pp->depth) )
+			return was_dead;
+		if ( pp->taken[pp->depth] == 1 )
+			pp->dead_depth = pp->depth;
+		else if ( pp->dead_depth == pp->depth )
+		{
+			pp->dead_depth = 0;
+			pp->taken[pp->depth] = 1;
+		}
+	}
+	else if ( len == 5 && strncmp(word, "endif", 5) == 0 && pp->depth > 0 )
+	{
+		if ( pp->dead_depth == pp->depth )
+			pp->dead_depth = 0;
+		pp->depth--;
+	}
+
+	return was_dead && pp->dead_depth != 0;
+}
+
+/*
+ * FUNCTION
+ *	int eval_condition(char expr[])
+ * DESCRIPTION
+ *	Evaluates the simple #if conditions that disable code: 0, 1, a macro
+ *	named with -U, defined(MACRO), and their negations with '!'.
+ * PARAMETERS
+ *	char expr[] - the condition following #if or #elif
+ * RETURN VALUE
+ *	0 if false, 1 if true, 2 if it cannot be evaluated
+ */
+int eval_condition(char expr[])
+{
+	char *p = expr + strspn(expr, " \t");
+	int negate = 0;
+	int paren = 0;
+	int len;
+	int cond;
+
+	while ( *p == '!' )
+	{
+		negate = !negate;
+		p += 1 + strspn(p + 1, " \t");
+	}
+
+	if ( strncmp(p, "defined", 7) == 0 && !isalnum((unsigned char)p[7]) && p[7] != '_' )
+	{
+		p += 7 + strspn(p + 7, " \t");
+		if ( *p == '(' )
+		{
+			paren = 1;
+			p += 1 + strspn(p + 1, " \t");
+		}
+		len = 0;
+		while ( isalnum((unsigned char)p[len]) || p[len] == '_' )
+			len++;
+		if ( len == 0 || !is_undef(p, len) )
+			return 2;
+		cond = 0;
+		p += len + strspn(p + len, " \t");
+		if ( paren && *p++ != ')' )
+			return 2;
+	}
+	else if ( *p == '0' || *p == '1' )
+	{
+		cond = *p++ - '0';
+	}
+	else
+	{
+		len = 0;
+		while ( isalnum((unsigned char)p[len]) || p[len] == '_' )
+			len++;
+		if ( len == 0 || !is_undef(p, len) )
+			return 2;
+		cond = 0;	/* an undefined macro is 0 */
+		p += len;
+	}
+
+	/* anything but a comment after the condition is too complex */
+	p += strspn(p, " \t\r\n");
+	if ( *p != '\0' && strncmp(p, "/*", 2) != 0 && strncmp(p, "//", 2) != 0 )
+		return 2;
+
+	return negate ? !cond : cond;
+}
+
+/*
+ * FUNCTION
+ *	int is_undef(char name[], int len)
+ * DESCRIPTION
+ *	Tests whether a macro name was given with -U.
+ * PARAMETERS
+ *	char name[] - the macro name, not NUL terminated
+ *	int len - length of the name
+ * RETURN VALUE
+ *	1 if the macro is known to be undefined, otherwise 0
+ */
+int is_undef(char name[], int len)
+{
+	int n;
+
+	for ( n = 0; n < opts.undefs.count; n++ )
+		if ( (int)strlen(opts.undefs.names[n]) == len
+		     && strncmp(opts.undefs.names[n], name, len) == 0 )
+			return 1;
+	return 0;
+}
+
+/*
+ * FUNCTION
+ *	void add_name(struct name_list *list, char name[])
+ * DESCRIPTION
+ *	Adds a copy of a source code file name to a list of names.
+ * PARAMETERS
+ *	struct name_list *list - the list of names
+ *	char name[] - the file name
+ * RETURN VALUE
+ *	None, exits if out of memory
+ */
+void add_name(struct name_list *list, char name[])
+{
+	if ( list->count == list->size )
+	{
+		list->size = list->size ? list->size * 2 : 64;
+		list->names = realloc(list->names, list->size * sizeof(char *));
+		if ( list->names == NULL )
+		{
+			fprintf(stderr, "Out of space\n");
+			exit(1);
+		}
+	}
+
+	list->names[list->count] = malloc(strlen(name) + 1);
+	if ( list->names[list->count] == NULL )
+	{
+		fprintf(stderr, "Out of space\n");
+		exit(1);
+	}
+	strcpy(list->names[list->count++], name);
+}
+
+/*
+ * FUNCTION
+ *	void read_list_file(struct name_list *list, char list_file[])
+ * DESCRIPTION
+ *	Adds the file names in a response file, one per line, to a list of
+ *	names. Blank lines are skipped.
+ * PARAMETERS
+ *	struct name_list *list - the list of names
+ *	char list_file[] - name of the response file
+ * RETURN VALUE
+ *	None, exits if the response file cannot be opened or holds a name
+ *	too long for PATH_LEN
+ */
+void read_list_file(struct name_list *list, char list_file[])
+{
+	char name[PATH_LEN];
+	FILE *lp;
+	int ch;
+
+	lp = fopen(list_file, "r");
+	if ( lp == NULL )
+	{
+		fprintf(stderr, "Cannot open %s\n", list_file);
+		exit(1);
+	}
+
+	while ( fgets(name, PATH_LEN, lp) )
+	{
+		if ( strchr(name, '\n') == NULL && (ch = getc(lp)) != EOF && ch != '\n' )
+		{
+			fprintf(stderr, "File name too long in %s: %.40s...\n", list_file, name);
+			exit(1);
+		}
+		name[strcspn(name, "\r\n")] = '\0';
+		if ( strcmp(name, "") != 0 )
+			add_name(list, name);
+	}
+	fclose(lp);
+}
+
+/*
+ * FUNCTION
+ *	void read_null_names(struct name_list *list)
+ * DESCRIPTION
+ *	Adds the NUL separated file names read from standard input, as
+ *	written by find -print0, to a list of names.
+ * PARAMETERS
+ *	struct name_list *list - the list of names
+ * RETURN VALUE
+ *	None, exits if a name is too long for PATH_LEN
+ */
+void read_null_names(struct name_list *list)
+{
+	char name[PATH_LEN];
+	FILE *np;
+	int ch;
+	int n = 0;
+
+	np = binary_stdin();
+	while ( (ch = getc(np)) != EOF )
+	{
+		if ( ch != '\0' && n == PATH_LEN - 1 )
+		{
+			name[n] = '\0';
+			fprintf(stderr, "File name too long: %.40s...\n", name);
+			exit(1);
+		}
+		else if ( ch != '\0' )
+			name[n++] = ch;
+		else
+		{
+			name[n] = '\0';
+			if ( n > 0 )
+				add_name(list, name);
+			n = 0;
+		}
+	}
+	name[n] = '\0';
+	if ( n > 0 )
+		add_name(list, name);
+}
+
+/*
+ * FUNCTION
+ *	void collect_names(struct name_list *list, char arg[])
+ * DESCRIPTION
+ *	Adds the source code files named by a command line argument to a
+ *	list of names: the files in a response file for @file, the NUL
+ *	separated names on standard input for -0, the source code files in
+ *	a directory tree, or else the argument itself.
+ * PARAMETERS
+ *	struct name_list *list - the list of names
+ *	char arg[] - the argument
+ * RETURN VALUE
+ *	None, exits if a response file or directory cannot be read
+ */
+void collect_names(struct name_list *list, char arg[])
+{
+	struct stat st;
+
+	if ( arg[0] == '@' )
+		read_list_file(list, arg + 1);
+	else if ( strcmp(arg, "-0") == 0 )
+		read_null_names(list);
+	else if ( stat(arg, &st) == 0 && S_ISDIR(st.st_mode) )
+		add_tree(list, arg);
+	else
+		add_name(list, arg);
+}
+
+/*
+ * FUNCTION
+ *	void add_tree(struct name_list *list, char dir[])
+ * DESCRIPTION
+ *	Adds the C and C++ source code files in a directory and its
+ *	subdirectories to a list of names, in name order so that every run
+ *	over the tree counts the files in the same order. Names starting
+ *	with '.' are skipped.
+ * PARAMETERS
+ *	struct name_list *list - the list of names
+ *	char dir[] - the directory
+ * RETURN VALUE
+ *	None, exits if the directory cannot be read or a name is too long
+ */
+void add_tree(struct name_list *list, char dir[])
+{
+	struct name_list entries;	/* the names in dir */
+	char path[PATH_LEN];
+	struct stat st;
+	size_t len = strlen(dir);
+	int n;
+#ifdef _WIN32
+	WIN32_FIND_DATAA found;
+	HANDLE hp;
+#else
+	struct dirent *found;
+	DIR *dp;
+#endif
+
+	memset(&entries, 0, sizeof(entries));
+	while ( len > 1 && (dir[len - 1] == '/' || dir[len - 1] == '\\') )
+		len--;
+	if ( len + 3 > PATH_LEN )
+	{
+		fprintf(stderr, "Name too long: %s\n", dir);
+		exit(1);
+	}
+
+#ifdef _WIN32
+	memcpy(path, dir, len);
+	strcpy(path + len, "\\*");
+	hp = FindFirstFileA(path, &found);
+	if ( hp == INVALID_HANDLE_VALUE )
+	{
+		fprintf(stderr, "Cannot read %s\n", dir);
+		exit(1);
+	}
+	do
+		if ( found.cFileName[0] != '.' )
+			add_name(&entries, found.cFileName);
+	while ( FindNextFileA(hp, &found) );
+	FindClose(hp);
+#else
+	dp = opendir(dir);
+	if ( dp == NULL )
+	{
+		fprintf(stderr, "Cannot read %s\n", dir);
+		exit(1);
+	}
+	while ( (found = readdir(dp)) != NULL )
+		if ( found->d_name[0] != '.' )
+			add_name(&entries, found->d_name);
+	closedir(dp);
+#endif
+	qsort(entries.names, entries.count, sizeof(char *), compare_name);
+
+	for ( n = 0; n < entries.count; n++ )
+	{
+		if ( len + 1 + strlen(entries.names[n]) >= PATH_LEN )
+		{
+			fprintf(stderr, "Name too long: %.*s/%s\n", (int)len, dir,
+				entries.names[n]);
+			exit(1);
+		}
+		memcpy(path, dir, len);
+		path[len] = '/';
+		strcpy(path + len + 1, entries.names[n]);
+		if ( stat(path, &st) != 0 )
+			continue;
+		if ( S_ISDIR(st.st_mode) )
+			add_tree(list, path);
+		else if ( is_source_name(path) )
+			add_name(list, path);
+	}
+	free_names(&entries);
+}
+
+/*
+ * FUNCTION
+ *	int is_source_name(char name[])
+ * DESCRIPTION
+ *	Checks the extension of a file found in a directory tree for a C or
+ *	C++ source code or header file.
+ * PARAMETERS
+ *	char name[] - the file name
+ * RETURN VALUE
+ *	1 if the file is counted, otherwise 0
+ */
+int is_source_name(char name[])
+{
+	static char *extensions[] = { "c", "h", "cc", "cpp", "cxx", "c++",
+				      "hh", "hpp", "hxx", "h++", "inl", NULL };
+	char ext[8];
+	char *dot = strrchr(name, '.');
+	int n;
+
+	if ( dot == NULL || strpbrk(dot, "/\\") != NULL || strlen(dot + 1) >= sizeof(ext) )
+		return 0;
+	for ( n = 0; dot[n + 1]; n++ )
+		ext[n] = tolower((unsigned char)dot[n + 1]);
+	ext[n] = '\0';
+	for ( n = 0; extensions[n] != NULL; n++ )
+		if ( strcmp(ext, extensions[n]) == 0 )
+			return 1;
+	return 0;
+}
+
+/*
+ * FUNCTION
+ *	int compare_name(const void *a, const void *b)
+ * DESCRIPTION
+ *	qsort() comparison of two names in a list of names.
+ * PARAMETERS
+ *	const void *a, const void *b - pointers to the names compared
+ * RETURN VALUE
+ *	Less than, equal to or greater than zero as a sorts before, with or
+ *	after b
+ */
+int compare_name(const void *a, const void *b)
+{
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/*
+ * FUNCTION
+ *	void free_names(struct name_list *list)
+ * DESCRIPTION
+ *	frees the memory allocated for a list of names
+ * PARAMETERS
+ *	struct name_list *list - the list of names
+ * RETURN VALUE
+ *	None
+ */
+void free_names(struct name_list *list)
+{
+	int n;
+
+	for ( n = 0; n < list->count; n++ )
+		free(list->names[n]);
+	free(list->names);
+	memset(list, 0, sizeof(*list));
+}
+
+/*
+ * FUNCTION
+ *	struct file_data *count_file(struct input *in, char source[])
+ * DESCRIPTION
+ *	Counts the lines of code and functions in a source code file.
+ *	The functions found are added to the end of the linked list and the
+ *	totals for the file are added to the end of the list of files.
+ * PARAMETERS
+ *	struct input *in - the source code, an open file or held in memory
+ *	char source[] - name of the source code file
+ * RETURN VALUE
+ *	The file record holding the totals for the file.
+ */
+struct file_data *count_file(struct input *in, char source[])
+{
+	/* buffers; a header line is kept by swapping buffers, not copying */
+	char lines[3][BUF_LEN];
+	char *buffer = lines[0];	/* line of source code being examined */
+	char *fn_name1 = lines[1];	/* function name */
+	char *fn_name2 = lines[2];	/* 2nd line of function name */
+	char *spare;			/* buffer given up for a kept line */
+	int keep;		/* buffer is kept as 1 fn_name1, 2 fn_name2 */
+
+	int i;			/* loops index */
+	int prg_loc = 0;	/* running loc count */
+	int fn_loc = 0;		/* lines of code in current function */
+	int fn_count = 0;	/* running function count */
+	int total_fn_loc = 0;	/* running function loc count */
+	int line_no = 0;	/* physical line number of buffer */
+	int new_line = 1;	/* buffer starts a new physical line */
+	int line_start;		/* buffer is the start of a physical line */
+	int dead_line = 0;	/* buffer is in a disabled #if region */
+	long offset = 0;	/* byte offset of buffer in the file */
+	long line_offset = 0;	/* byte offset of the current physical line */
+	struct fn_pos fn_pos;	/* location of the current function */
+	struct file_data *rec;	/* totals for the file */
+	struct pp_state pp;	/* preprocessor conditionals */
+	struct scope_state sc;	/* open braces for --braces */
+	int braces;		/* functions are found by brace matching */
+	int scan;		/* the lexer of scan_scope() is needed */
+	STYLE style;		/* coding style of the file */
+	int n;
+
+	/* initial line and function states */
+	STATETYPE state = NewLine;
+	FNSTATETYPE fn_state = NotFunction;
+	fn_name1[0] = '\0';
+	fn_name2[0] = '\0';
+	memset(&pp, 0, sizeof(pp));
+	sc.lex = LexCode;
+	sc.prev = '\n';
+	sc.blank_line = 1;
+	sc.depth = sc.fn_depth = 0;
+	sc.header_len = 0;
+	sc.word_len = 0;
+	sc.base_depth = 0;
+	memset(&sc.metrics, 0, sizeof(sc.metrics));
+
+	rec = insert_file(source);
+	detect_encoding(in);
+
+	if ( opts.special != SpecialCount )
+	{
+		rec->kind = prescan(in);
+		if ( rec->kind == FileBinary || (rec->kind != FileSource
+		     && opts.special == SpecialSkip) )
+		{
+			rec->skipped = 1;
+			return rec;
+		}
+	}
+	braces = opts.braces && rec->kind == FileSource;
+	scan = (braces || opts.metrics) && rec->kind == FileSource;
+	style = style_for(source);
+
+	while ( !input_eof(in) )
+	{
+		if ( read_chunk(buffer, BUF_LEN, in) )
+		{
+			keep = 0;
+
+			/* long lines are read in pieces; count each line once */
+			line_start = new_line;
+			if ( new_line )
+			{
+				line_no++;
+				line_offset = offset;
+			}
+			offset += in->raw;
+			new_line = in->eol;
+
+			sc.line_no = line_no;
+			sc.line_offset = line_offset;
+			sc.end_offset = offset;
+			sc.touched = sc.fn_depth != 0;
+			sc.closed_count = 0;
+
+			/* lines in a disabled #if region bypass the line states */
+			if ( opts.dead_code )
+			{
+				if ( line_start )
+					dead_line = state == NewLine && dead_region(buffer, &pp);
+				if ( dead_line )
+				{
+					if ( line_start && buffer[strspn(buffer, " \t\n")] != '\0' )
+						rec->dead_loc++;
+					if ( opts.line_map != NULL )
+					{
+						lmap.flags |= LM_DEAD | LM_TEXT;
+						if ( new_line )
+							map_line(line_offset);
+					}
+					continue;
+				}
+			}
+
+			/* headers to follow for --tu */
+			if ( opts.tu && line_start && state == NewLine )
+				note_include(buffer);
+
+			for ( i= 0; i < strlen(buffer); i++ )
+			{
+				switch (state)
+				{
+				case (NewLine) :
+					state = next_new_line(buffer[i]);
+					break;
+				case (NewLineNC) :
+					break;
+				case (PosComment) :
+					state = next_pos_comment(buffer[i]);
+					break;
+				case (CppComment) :
+					state = next_cpp_comment(buffer[i]);
+					break;
+				case (Comment) :
+					state = next_comment(buffer[i]);
+					break;
+				case (PosEndComment) :
+					state = next_pos_end_comment(buffer[i]);
+					break;
+				case (EndComment) :
+					state = NewLineNC;
+					break;
+				case (CompDir) :
+					state = next_comp_dir(buffer[i]);
+					break;
+				case (LineOfCode) :
+					state = next_line_of_code(buffer[i]);
+					break;
+				case (OpenBracket) :
+					state = next_open_bracket(buffer[i]);
+					break;
+				case (CloseBracket1) :
+					state = next_close_bracket1(buffer[i]);
+					break;
+				case (CloseBracket2) :
+					state = next_close_bracket2(buffer[i]);
+					break;
+				case (PosEOL) :
+					state = next_pos_eol(buffer[i]);
+					break;
+				case (InlineComment) :
+					state = next_inline_comment(buffer[i]);
+					break;
+				}	/* end switch(state) */
+
+				if ( opts.line_map != NULL )
+					map_char(buffer[i], state);
+				if ( scan )
+					scan_scope(&sc, buffer[i]);
+			}	/* end for loop */
+
+			if ( rec->kind == FileSource && !braces && isalpha(buffer[0]) )
+			{
+				/* GNU style: the name follows its return type */
+				if ( style == StyleGnu && fn_state == PosFunction
+				     && fn_name2[0] == '\0' && strpbrk(fn_name1, "(;=") == NULL )
+					keep = 2;
+				else
+				{
+					fn_state = PosFunction;
+					keep = 1;
+					fn_name2[0] = '\0';
+					fn_loc = 0;
+					fn_pos.start_line = line_no;
+					fn_pos.start_offset = line_offset;
+				}
+			}
+
+			if ( fn_state == PosFunction )
+			{
+				switch (buffer[0])
+				{
+					case '{':
+						if ( (style == StyleAllman || style == StyleGnu)
+						     && strchr(fn_name1, '(') == NULL
+						     && strchr(fn_name2, '(') == NULL )
+						{
+							/* a struct or initializer, not a function */
+							fn_state = NotFunction;
+							fn_name1[0] = '\0';
+							fn_name2[0] = '\0';
+							break;
+						}
+						fn_state = IsFunction;
+						fn_count++;
+						sc.base_depth = sc.depth;
+						memset(&sc.metrics, 0, sizeof(sc.metrics));
+						break;
+					case ' ':
+					case '\t':
+						if ( style != StyleGnu || fn_name2[0] == '\0' )
+							keep = 2;
+						break;
+					case '}':
+						fn_state = NotFunction;
+						fn_name1[0] = '\0';
+						fn_name2[0] = '\0';
+				}
+			}
+
+			if ( state == NewLine )
+			{
+				prg_loc++;
+				lmap.flags |= LM_COUNTED;
+				if ( opts.max_file_loc > 0 && prg_loc > opts.max_file_loc )
+				{
+					rec->over = OverFile;
+					rec->over_line = line_no;
+					break;
+				}
+			}
+
+			if ( state == NewLine && fn_state == IsFunction )
+			{
+				fn_loc++;
+				total_fn_loc++;
+				if ( opts.max_fn_loc > 0 && fn_loc > opts.max_fn_loc )
+				{
+					fn_pos.end_line = line_no;
+					fn_pos.end_offset = offset;
+					insert_at_end(fn_name1, fn_name2, source, &fn_pos, fn_loc);
+					last->metrics = sc.metrics;
+					if ( rec->first_fn == NULL )
+						rec->first_fn = last;
+					rec->over = OverFunction;
+					rec->over_line = fn_pos.start_line;
+					rec->over_fn = last;
+					break;
+				}
+			}
+
+			/* functions open during the line share its LOC */
+			if ( braces )
+			{
+				if ( state == NewLine && sc.touched )
+				{
+					if ( sc.fn_depth != 0 )
+						sc.open_fn.loc++;
+					for ( n = 0; n < sc.closed_count; n++ )
+						sc.closed[n].loc++;
+				}
+				for ( n = 0; n < sc.closed_count; n++ )
+				{
+					insert_at_end(sc.closed[n].name1, sc.closed[n].name2,
+						      source, &sc.closed[n].pos, sc.closed[n].loc);
+					last->metrics = sc.closed[n].metrics;
+					if ( rec->first_fn == NULL )
+						rec->first_fn = last;
+					fn_count++;
+					total_fn_loc += sc.closed[n].loc;
+					if ( opts.max_fn_loc > 0 && sc.closed[n].loc > opts.max_fn_loc )
+						break;
+				}
+				if ( n < sc.closed_count || (opts.max_fn_loc > 0
+				     && sc.fn_depth != 0 && sc.open_fn.loc > opts.max_fn_loc) )
+				{
+					if ( n == sc.closed_count )
+					{
+						sc.open_fn.pos.end_line = line_no;
+						sc.open_fn.pos.end_offset = offset;
+						insert_at_end(sc.open_fn.name1, sc.open_fn.name2,
+							      source, &sc.open_fn.pos, sc.open_fn.loc);
+						last->metrics = sc.metrics;
+						if ( rec->first_fn == NULL )
+							rec->first_fn = last;
+					}
+					rec->over = OverFunction;
+					rec->over_line = last->pos.start_line;
+					rec->over_fn = last;
+					break;
+				}
+			}
+
+			if ( state == NewLineNC )
+				state = NewLine;
+
+			if ( fn_state == IsFunction && buffer[0] == '}' )
+			{
+				fn_pos.end_line = line_no;
+				fn_pos.end_offset = offset;
+				insert_at_end(fn_name1, fn_name2, source, &fn_pos, fn_loc);
+				last->metrics = sc.metrics;
+				if ( rec->first_fn == NULL )
+					rec->first_fn = last;
+				fn_state = NotFunction;
+				fn_name1[0] = '\0';
+				fn_name2[0] = '\0';
+				fn_loc = 0;
+			}
+
+			/* keep a possible header line by trading buffers with it */
+			if ( keep == 1 )
+			{
+				spare = fn_name1;
+				fn_name1 = buffer;
+				buffer = spare;
+			}
+			else if ( keep == 2 )
+			{
+				spare = fn_name2;
+				fn_name2 = buffer;
+				buffer = spare;
+			}
+
+			if ( opts.line_map != NULL && new_line )
+				map_line(line_offset);
+		}	/* end if( read_chunk(... */
+	}	/* end while (!input_eof(in)) loop */
+
+	if ( opts.line_map != NULL )
+	{
+		if ( !new_line )
+			map_line(line_offset);
+		write_line_map(opts.line_map, offset);
+	}
+
+	rec->prg_loc = prg_loc;
+	rec->fn_count = fn_count;
+	rec->fn_loc = total_fn_loc;
+	rec->end_state = state;
+	rec->lines = line_no;
+	rec->bytes = offset;
+
+	return rec;
+}
+
+/*
+ * FUNCTION
+ *	int input_eof(struct input *in)
+ * DESCRIPTION
+ *	Tests for the end of the source code, as feof() does for a stream.
+ *	When a stream's block has been used up the next block is read.
+ * PARAMETERS
+ *	struct input *in - the source code being counted
+ * RETURN VALUE
+ *	Non-zero at the end of the source code
+ */
+int input_eof(struct input *in)
+{
+	if ( in->pos < in->size )
+		return 0;
+	if ( in->encoding == EncUtf16LE || in->encoding == EncUtf16BE )
+		return fill_utf16(in) == 0;
+	if ( in->fd < 0 && in->fp == NULL )
+		return 1;
+
+	in->data = in->block;
+	in->size = read_source(in, (unsigned char *)in->block, BLOCK_LEN);
+	in->pos = 0;
+	return in->size == 0;
+}
+
+/*
+ * FUNCTION
+ *	int open_source(struct input *in, char source[])
+ * DESCRIPTION
+ *	Opens a source code file to be read by count_file() with read()
+ *	rather than stdio. Most source files fit in one input block, so they
+ *	are read with a single read() into the block of the input, which the
+ *	caller keeps on its stack; nothing is allocated per file. A regular
+ *	file that fits in the block is known to be at its end once its size
+ *	has been read, saving the read() that would return 0. Only the state
+ *	of the input is cleared, not its buffers.
+ * PARAMETERS
+ *	struct input *in - receives the open file
+ *	char source[] - name of the source code file
+ * RETURN VALUE
+ *	1 if the file was opened, 0 if it could not be
+ */
+int open_source(struct input *in, char source[])
+{
+	int fd;
+
+	fd = open(source, O_RDONLY | O_BINARY);
+	if ( fd < 0 )
+	{
+		fprintf(stderr, "Cannot open %s\n", source);
+		return 0;
+	}
+	start_source(in, fd, source);
+	return 1;
+}
+
+/*
+ * FUNCTION
+ *	void start_source(struct input *in, int fd, char source[])
+ * DESCRIPTION
+ *	Sets up an input to read an open source code file from its current
+ *	position, as open_source() does for the files it opens.
+ * PARAMETERS
+ *	struct input *in - receives the open file
+ *	int fd - the open file, closed by close_source()
+ *	char source[] - name of the source code file
+ * RETURN VALUE
+ *	None
+ */
+void start_source(struct input *in, int fd, char source[])
+{
+	struct stat st;
+
+	in->fd = fd;
+	in->at_end = 0;
+	in->expect = -1;
+	if ( fstat(in->fd, &st) == 0 && S_ISREG(st.st_mode)
+	     && st.st_size <= BLOCK_LEN )
+		in->expect = (long)st.st_size;
+	in->name = source;
+	in->fp = NULL;
+	in->data = in->block;
+	in->size = in->pos = 0;
+	in->raw = in->bias = 0;
+	in->eol = 0;
+	in->encoding = EncUnknown;
+	in->src = NULL;
+	in->src_size = in->src_pos = 0;
+	in->wide_len = 0;
+	in->high = 0;
+	in->read_time = 0.0;
+}
+
+/*
+ * FUNCTION
+ *	void close_source(struct input *in)
+ * DESCRIPTION
+ *	Closes a source code file opened by open_source().
+ * PARAMETERS
+ *	struct input *in - the open file
+ * RETURN VALUE
+ *	None
+ */
+void close_source(struct input *in)
+{
+	close(in->fd);
+	in->fd = -1;
+	free(in->src);		/* UTF-16 read from a pipe */
+	in->src = NULL;
+}
+
+/*
+ * FUNCTION
+ *	void detect_encoding(struct input *in)
+ * DESCRIPTION
+ *	Looks at the first bytes of the source code for a byte order mark or
+ *	the zero bytes of ASCII text in UTF-16. A UTF-8 byte order mark is
+ *	skipped. UTF-16 source code is transcoded to UTF-8 as it is read;
+ *	anything else is read as it is.
+ * PARAMETERS
+ *	struct input *in - the source code, before anything has been read
+ * RETURN VALUE
+ *	None
+ */
+void detect_encoding(struct input *in)
+{
+	unsigned char *b;
+	long bom = 0;
+
+	in->encoding = EncBytes;
+	if ( input_eof(in) || in->size - in->pos < 2 )
+		return;
+	b = (unsigned char *)in->data + in->pos;
+
+	if ( in->size - in->pos >= 3 && b[0] == 0xef && b[1] == 0xbb && b[2] == 0xbf )
+	{
+		in->pos += 3;
+		in->bias = 3;
+		return;
+	}
+	else if ( b[0] == 0xff && b[1] == 0xfe )
+	{
+		in->encoding = EncUtf16LE;
+		bom = 2;
+	}
+	else if ( b[0] == 0xfe && b[1] == 0xff )
+	{
+		in->encoding = EncUtf16BE;
+		bom = 2;
+	}
+	else if ( in->size - in->pos >= 4 && b[0] && !b[1] && b[2] && !b[3] )
+		in->encoding = EncUtf16LE;
+	else if ( in->size - in->pos >= 4 && !b[0] && b[1] && !b[2] && b[3] )
+		in->encoding = EncUtf16BE;
+	else
+		return;
+
+	/* transcode from the start of the file, stream or memory */
+	if ( in->fd >= 0 && lseek(in->fd, bom, SEEK_SET) == bom )
+	{
+		in->at_end = 0;
+		if ( in->expect >= 0 )
+			in->expect += in->size - bom;
+	}
+	else if ( in->fd >= 0 )
+	{
+		/* a pipe can't be rewound: transcode a copy of what was read */
+		in->src = malloc(in->size - in->pos - bom + 1);
+		if ( in->src == NULL )
+		{
+			fprintf(stderr, "Out of space\n");
+			exit(1);
+		}
+		memcpy(in->src, in->data + in->pos + bom, in->size - in->pos - bom);
+		in->src_size = in->size - in->pos - bom;
+		in->src_pos = 0;
+	}
+	else if ( in->fp != NULL )
+		fseek(in->fp, bom, SEEK_SET);
+	else
+	{
+		in->src = in->data + in->pos + bom;
+		in->src_size = in->size - in->pos - bom;
+		in->src_pos = 0;
+	}
+	in->bias = bom;
+	in->size = in->pos = 0;
+}
+
+/*
+ * FUNCTION
+ *	long read_source(struct input *in, unsigned char dst[], long len)
+ * DESCRIPTION
+ *	Reads up to len bytes of source code from the file, stream or memory.
+ * PARAMETERS
+ *	struct input *in - the source code being counted
+ *	unsigned char dst[] - receives the bytes
+ *	long len - the most bytes to read
+ * RETURN VALUE
+ *	The number of bytes read
+ */
+long read_source(struct input *in, unsigned char dst[], long len)
+{
+	double start = opts.prom_file != NULL ? wall_clock() : 0.0;
+	long got;
+
+	/* UTF-16 in memory, or read from a pipe before it was detected */
+	if ( in->src_pos < in->src_size )
+	{
+		if ( len > in->src_size - in->src_pos )
+			len = in->src_size - in->src_pos;
+		memcpy(dst, in->src + in->src_pos, len);
+		in->src_pos += len;
+		return len;
+	}
+
+	if ( in->fd >= 0 )
+	{
+		/* a read() of 0 bytes, or the last of a small file, is the end */
+		if ( in->at_end )
+			return 0;
+		if ( in->feed != NULL )
+			feed_pipe(in);
+		do
+			got = read(in->fd, dst, len);
+		while ( got < 0 && errno == EINTR );
+		if ( got < 0 )
+		{
+			fprintf(stderr, "Cannot read %s: %s\n", in->name, strerror(errno));
+			got = 0;
+		}
+		if ( got == 0 || (in->expect >= 0 && (in->expect -= got) <= 0) )
+			in->at_end = 1;
+		if ( opts.prom_file != NULL )
+			in->read_time += wall_clock() - start;
+		return got;
+	}
+	if ( in->fp != NULL )
+	{
+		got = fread(dst, 1, len, in->fp);
+		if ( opts.prom_file != NULL )
+			in->read_time += wall_clock() - start;
+		return got;
+	}
+	return 0;
+}
+
+/*
+ * FUNCTION
+ *	long fill_utf16(struct input *in)
+ * DESCRIPTION
+ *	Reads the next piece of UTF-16 source code and transcodes it to UTF-8
+ *	in the input block. An odd byte or a high surrogate at the end of a
+ *	piece is kept for the next one. Unpaired surrogates are dropped.
+ * PARAMETERS
+ *	struct input *in - the source code being counted
+ * RETURN VALUE
+ *	The number of UTF-8 bytes in the block, 0 at the end of the source
+ */
+long fill_utf16(struct input *in)
+{
+	unsigned char *w = in->wide;
+	unsigned long cp;
+	unsigned unit;
+	long got, i;
+	long n = 0;
+
+	do
+	{
+		got = read_source(in, w + in->wide_len, WIDE_LEN - in->wide_len);
+		if ( got == 0 )
+			break;
+		got += in->wide_len;
+
+		for ( i = 0; i + 1 < got; i += 2 )
+		{
+			if ( in->encoding == EncUtf16LE )
+				unit = w[i] | (w[i + 1] << 8);
+			else
+				unit = (w[i] << 8) | w[i + 1];
+
+			if ( unit >= 0xd800 && unit < 0xdc00 )
+			{
+				in->high = unit;
+				continue;
+			}
+			if ( unit >= 0xdc00 && unit < 0xe000 )
+			{
+				if ( in->high == 0 )
+					continue;
+				cp = 0x10000 + ((in->high - 0xd800) << 10) + (unit - 0xdc00);
+			}
+			else
+				cp = unit;
+			in->high = 0;
+
+			if ( cp < 0x80 )
+				in->block[n++] = cp;
+			else if ( cp < 0x800 )
+			{
+				in->block[n++] = 0xc0 | (cp >> 6);
+				in->block[n++] = 0x80 | (cp & 0x3f);
+			}
+			else if ( cp < 0x10000 )
+			{
+				in->block[n++] = 0xe0 | (cp >> 12);
+				in->block[n++] = 0x80 | ((cp >> 6) & 0x3f);
+				in->block[n++] = 0x80 | (cp & 0x3f);
+			}
+			else
+			{
+				in->block[n++] = 0xf0 | (cp >> 18);
+				in->block[n++] = 0x80 | ((cp >> 12) & 0x3f);
+				in->block[n++] = 0x80 | ((cp >> 6) & 0x3f);
+				in->block[n++] = 0x80 | (cp & 0x3f);
+			}
+		}
+
+		/* keep an odd byte for the next piece */
+		in->wide_len = got - i;
+		if ( in->wide_len )
+			w[0] = w[i];
+	} while ( n == 0 );
+
+	in->data = in->block;
+	in->size = n;
+	in->pos = 0;
+	return n;
+}
+
+/*
+ * FUNCTION
+ *	char *read_chunk(char buffer[], int len, struct input *in)
+ * DESCRIPTION
+ *	Reads the next line of source code, or the next len - 1 characters of
+ *	a longer line, into buffer, as fgets() would. Lines may end with
+ *	"\n", "\r\n" or a bare "\r", in any mix; every line ending is stored
+ *	in buffer as a single '\n' so the line states only see '\n'. The bytes
+ *	taken from the source are left in in->raw and in->eol is set if the
+ *	chunk ended a line.
+ * PARAMETERS
+ *	char buffer[] - receives the line
+ *	int len - size of buffer
+ *	struct input *in - the source code being counted
+ * RETURN VALUE
+ *	buffer, or NULL at the end of the source code
+ */
+char *read_chunk(char buffer[], int len, struct input *in)
+{
+	int n = 0;
+	char ch;
+
+	in->raw = in->bias;
+	in->bias = 0;
+	in->eol = 0;
+
+	while ( n < len - 1 && !input_eof(in) )
+	{
+		ch = in->data[in->pos++];
+		in->raw++;
+
+		if ( ch == '\r' )
+		{
+			/* "\r\n" is one line ending, even across blocks */
+			ch = '\n';
+			if ( !input_eof(in) && in->data[in->pos] == '\n' )
+			{
+				in->pos++;
+				in->raw++;
+			}
+		}
+
+		buffer[n++] = ch;
+		if ( ch == '\n' )
+		{
+			in->eol = 1;
+			break;
+		}
+	}
+
+	if ( n == 0 )
+		return NULL;
+	buffer[n] = '\0';
+
+	return buffer;
+}
+
+/*
+ * FUNCTION
+ *	STATETYPE next_new_line(char ch)
+ * DESCRIPTION
+ *	Determines the next state if in NewLine state.
+ * PARAMETERS
+ *	char ch - a character from the buffer containing the line of
+ * 		  code being examined.
+ * RETURN VALUE
+ *	Returns the new state.
+ * SIDE EFFECTS
+ *	None known
+ * LIMITATIONS
+ *	None known
+ */
+STATETYPE next_new_line(char ch)
+{
+	STATETYPE st;
+	if ( ch == '\n' )
+		st = NewLineNC;
+	else if ( isspace(ch) )
+		st = NewLine;
+	else
+		switch(ch)
+		{
+			case '/':
+				st = PosComment;
+				break;
+			case '#':
+				st = CompDir;
+				break;
+			case '{':
+				st = OpenBracket;
+				break;
+			case '}':
+				st = CloseBracket1;
+				break;
+			default:
+				st = LineOfCode;
+				break;
+	   	}
+
+	return st;
+}
+
+/*
+ * FUNCTION
+ *	STATETYPE next_pos_comment(char ch)
+ * DESCRIPTION
+ *	Determines the next state if in PosComment state.
+ * PARAMETERS
+ *	char ch - a character from the buffer containing the line of
+ * 		  code being examined.
+ * RETURN VALUE
+ *	Returns the new state.
+ * SIDE EFFECTS
+ *	None known
+ * LIMITATIONS
+ *	None known
+ */
+STATETYPE next_pos_comment(char ch)
+{
+	STATETYPE st;
+
+	switch (ch)
+	{
+		case '/':
+			st = CppComment;
+			break;
+		case '*':
+			st = Comment;
+			break;
+		default:
+			st = NewLineNC;
+			break;
+	}
+
+	return st;
+}
+
+/*
+ * FUNCTION
+ *	STATETYPE next_cpp_comment(char ch)
+ * DESCRIPTION
+ *	Determines the next stat if in CppComment state.
+ * PARAMETERS
+ *	char ch - a character from the buffer containing the line of
+ * 		  code being examined.
+ * RETURN VALUE
+ *	Returns the new state.
+ * SIDE EFFECTS
+ *	None known
+ * LIMITATIONS
+ *	None known
+ */
+STATETYPE next_cpp_comment(char ch)
+{
+    	STATETYPE st;
+
+    	if ( ch == '\n' )
+        	st = NewLineNC;
+    	else
+    		st = CppComment;
+
+    	return st;
+}
+
+/*
+ * FUNCTION
+ *	STATETYPE next_comment(char ch)
+ * DESCRIPTION
+ *	Determines the next state if in Comment state.
+ * PARAMETERS
+ *	char ch - a character from the buffer containing the line of
+ * 		  code being examined.
+ * RETURN VALUE
+ *	Returns the new state.
+ * SIDE EFFECTS
+ *	None known
+ * LIMITATIONS
+ *	None known
+ */
+STATETYPE next_comment(char ch)
+{
+	STATETYPE st;
+
+	if ( ch == '*' )
+		st = PosEndComment;
+	else
+		st = Comment;
+
+	return st;
+}
+
+/*
+ * FUNCTION
+ *	STATETYPE next_pos_end_comment(char ch)
+ * DESCRIPTION
+ *	Determines the next state if in PosEndComment state.
+ * PARAMETERS
+ *	char ch - a character from the buffer containing the line of
+ * 		  code being examined.
+ * RETURN VALUE
+ *	Returns the new state.
+ * SIDE EFFECTS
+ *	None known
+ * LIMITATIONS
+ *	None known
+ */
+STATETYPE next_pos_end_comment(char ch)
+{
+	STATETYPE st;
+
+	switch (ch)
+	{
+		case '/':
+			st = EndComment;
+			break;
+		case '*':
+			st = PosEndComment;
+			break;
+		default:
+			st = Comment;
+			break;
+	}
+
+	return st;
+}
+
+/*
+ * FUNCTION
+ *	STATETYPE next_comp_dir(char ch)
+ * DESCRIPTION
+ *	Determines the next state if in CompDir state.
+ * PARAMETERS
+ *	char ch - a character from the buffer containing the line of
+ * 		  code being examined.
+ * RETURN VALUE
+ *	Returns the new state.
+ * SIDE EFFECTS
+ *	None known
+ * LIMITATIONS
+ *	None known
+ */
+STATETYPE next_comp_dir(char ch)
+{
+	STATETYPE st;
+
+	if (ch == '\n')
+		st = NewLine;
+	else
+		st = CompDir;
+
+	return st;
+}
+
+/*
+ * FUNCTION
+ *	STATETYPE next_line_of_code(char ch)
+ * DESCRIPTION
+ *	Determines the next state if in LineOfCode state.
+ * PARAMETERS
+ *	char ch - a character from the buffer containing the line of
+ * 		  code being examined.
+ * RETURN VALUE
+ *	Returns the new state.
+ * SIDE EFFECTS
+ *	None known
+ * LIMITATIONS
+ *	None known
+ * MODIFICATION HISTORY
+ *	09-03-18 Removed case ',' and case ':'
+ */
+STATETYPE next_line_of_code(char ch)
+{
+	STATETYPE st;
+
+	switch (ch)
+	{
+		case '}':
+			st = CloseBracket2;
+			break;
+		case '{':
+		case ';':
+			st = PosEOL;
+			break;
+		default:
+			st = LineOfCode;
+			break;
+	}
+
+	return st;
+}
+
+/*
+ * FUNCTION
+ *	STATETYPE next_open_bracket(char ch)
+ * DESCRIPTION
+ *	Determines the next state if in OpenBracket state.
+ * PARAMETERS
+ *	char ch - a character from the buffer containing the line of
+ * 		  code being examined.
+ * RETURN VALUE
+ *	Returns the new state.
+ * SIDE EFFECTS
+ *	None known
+ * LIMITATIONS
+ *	None known
+ */
+STATETYPE next_open_bracket(char ch)
+{
+	STATETYPE st;
+
+	switch (ch)
+	{
+		case '\n':
+			st = NewLine;
+			break;
+		case '}':
+			st = CloseBracket2;
+			break;
+		default:
+			st = LineOfCode;
+			break;
+	}
+
+	return st;
+}
+
+/*
+ * FUNCTION
+ *	STATETYPE next_close_bracket1(char ch)
+ * DESCRIPTION
+ *	Determines the next state if in CloseBracket1 state.
+ * PARAMETERS
+ *	char ch - a character from the buffer containing the line of
+ * 		  code being examined.
+ * RETURN VALUE
+ *	Returns the new state.
+ * SIDE EFFECTS
+ *	None known
+ * LIMITATIONS
+ *	None known
+ */
+STATETYPE next_close_bracket1(char ch)
+{
+	STATETYPE st;
+
+	if ( ch == '\n' )
+		st = NewLineNC;
+	else
+		st = CloseBracket2;
+
+	return st;
+}
+
+/*
+ * FUNCTION
+ *	STATETYPE next_close_bracket2(char ch)
+ * DESCRIPTION
+ *	Determines the next state if in CloseBracket2 state.
+ * PARAMETERS
+ *	char ch - a character from the buffer containing the line of
+ * 		  code being examined.
+ * RETURN VALUE
+ *	Returns the new state.
+ * SIDE EFFECTS
+ *	None known
+ * LIMITATIONS
+ *	None known
+ */
+STATETYPE next_close_bracket2(char ch)
+{
+	STATETYPE st;
+
+	if ( ch == ';' )
+		st = PosEOL;
+	else
+		st = LineOfCode;
+
+	return st;
+}
+
+
+/*
+ * FUNCTION
+ *	STATETYPE next_pos_eol(char ch)
+ * DESCRIPTION
+ *	Determines the next state if in PosEOL state.
+ * PARAMETERS
+ *	char ch - a character from the buffer containing the line of
+ * 		  code being examined.
+ * RETURN VALUE
+ *	Returns the new state.
+ * SIDE EFFECTS
+ *	None known
+ * LIMITATIONS
+ *	None known
+ */
+STATETYPE next_pos_eol(char ch)
+{
+	STATETYPE st;
+
+	switch (ch)
+	{
+		case '\n':
+			st = NewLine;
+			break;
+		case ' ':
+		case '\t':
+			st = PosEOL;
+			break;
+		case '/':
+			st = InlineComment;
+			break;
+		default:
+			st = LineOfCode;
+			break;
+	}
+
+	return st;
+}
+
+/*
+ * FUNCTION
+ *	STATETYPE next_inline_comment(char ch)
+ * DESCRIPTION
+ *	Determines the next state if in InlineComment state.
+ * PARAMETERS
+ *	char ch - a character from the buffer containing the line of
+ * 		  code being examined.
+ * RETURN VALUE
+ *	Returns the new state.
+ * SIDE EFFECTS
+ *	None known
+ * LIMITATIONS
+ *	None known
+ */
+STATETYPE next_inline_comment(char ch)
+{
+	STATETYPE st;
+
+	if ( ch == '\n' )
+		st = NewLine;
+	else
+		st = InlineComment;
+
+	return st;
+}
+
+/*
+ * FUNCTION
+ *	void insert_at_end(fn_name, char fn_name2[], char file[],
+ *			   struct fn_pos *pos, fn_loc)
+ * DESCRIPTION
+ *	inserts data into a singly linked list at the head if it is the first
+ *	item, otherwise at the end.
+ * PARAMETERS
+ *	char fn_name[]	- character string holding the current function name
+ *	char fn_name2[] - character strng holding second line of function name
+ *	char file[] - name of the source file containing the function
+ *	struct fn_pos *pos - lines and byte offsets of the function
+ *	int fn_loc - integer holding the number of loc in the function
+ * RETURN VALUE
+ *	None, inserts data into the linked list
+ */
+void insert_at_end(char fn_name1[], char fn_name2[], char file[],
+		   struct fn_pos *pos, int fn_loc)
+{
+	node *current;
+	current = (node*)malloc(sizeof(node));
+
+	if ( current == NULL )
+	{
+		fprintf(stderr, "Out of space\n");
+		exit(1);
+	}
+	else
+	{
+		current->header = intern_header(fn_name1, fn_name2);
+		current->name1 = headers.list[current->header].name1;
+		current->name2 = headers.list[current->header].name2;
+		current->file = intern_path(file);
+		current->pos = *pos;
+		current->loc = fn_loc;
+		memset(&current->metrics, 0, sizeof(current->metrics));
+		current->next = NULL;
+		spill.used += sizeof(node);
+
+		if ( head == NULL )
+		{
+			head = current;
+			last = current;
+		}
+		else
+		{
+			last->next = current;
+			last = current;
+		}
+	}
+}
+
+/*
+ * FUNCTION
+ *	int intern_header(char fn_name1[], char fn_name2[])
+ * DESCRIPTION
+ *	Finds a function header in the header table, adding it if it is new,
+ *	and counts one more function with that header. The hash table is
+ *	doubled when it is half full.
+ * PARAMETERS
+ *	char fn_name1[] - first line of the header
+ *	char fn_name2[] - second line of the header, or ""
+ * RETURN VALUE
+ *	The ID of the header
+ */
+int intern_header(char fn_name1[], char fn_name2[])
+{
+	unsigned long h = 2166136261UL;
+	struct header *hdr;
+	size_t len1, len2;
+	char *p;
+	int slot, id, n;
+
+	for ( p = fn_name1; *p; p++ )
+		h = (h ^ (unsigned char)*p) * 16777619UL;
+	h = (h ^ '\n') * 16777619UL;
+	for ( p = fn_name2; *p; p++ )
+		h = (h ^ (unsigned char)*p) * 16777619UL;
+	h &= 0xffffffffUL;
+
+	if ( headers.slot_count != 0 )
+		for ( slot = h & (headers.slot_count - 1); headers.slots[slot] != 0;
+		      slot = (slot + 1) & (headers.slot_count - 1) )
+		{
+			hdr = &headers.list[headers.slots[slot] - 1];
+			if ( hdr->hash == h && strcmp(hdr->name1, fn_name1) == 0
+			     && strcmp(hdr->name2, fn_name2) == 0 )
+			{
+				hdr->count++;
+				return headers.slots[slot] - 1;
+			}
+		}
+
+	/* a new header: grow the list and the hash table as needed */
+	if ( headers.count == headers.size )
+	{
+		spill.used += (headers.size ? headers.size : 256) * sizeof(struct header);
+		headers.size = headers.size ? headers.size * 2 : 256;
+		headers.list = realloc(headers.list, headers.size * sizeof(struct header));
+		if ( headers.list == NULL )
+		{
+			fprintf(stderr, "Out of space\n");
+			exit(1);
+		}
+	}
+	if ( 2 * (headers.count + 1) > headers.slot_count )
+	{
+		free(headers.slots);
+		spill.used += (headers.slot_count ? headers.slot_count : 512) * sizeof(int);
+		headers.slot_count = headers.slot_count ? headers.slot_count * 2 : 512;
+		headers.slots = calloc(headers.slot_count, sizeof(int));
+		if ( headers.slots == NULL )
+		{
+			fprintf(stderr, "Out of space\n");
+			exit(1);
+		}
+		for ( n = 0; n < headers.count; n++ )
+		{
+			for ( slot = headers.list[n].hash & (headers.slot_count - 1);
+			      headers.slots[slot] != 0;
+			      slot = (slot + 1) & (headers.slot_count - 1) )
+				;
+			headers.slots[slot] = n + 1;
+		}
+	}
+
+	id = headers.count++;
+	hdr = &headers.list[id];
+	len1 = strlen(fn_name1);
+	len2 = strlen(fn_name2);
+	hdr->name1 = malloc(len1 + len2 + 2);
+	if ( hdr->name1 == NULL )
+	{
+		fprintf(stderr, "Out of space\n");
+		exit(1);
+	}
+	memcpy(hdr->name1, fn_name1, len1 + 1);
+	hdr->name2 = hdr->name1 + len1 + 1;
+	memcpy(hdr->name2, fn_name2, len2 + 1);
+	spill.used += len1 + len2 + 2;
+	hdr->hash = h;
+	hdr->count = 1;
+
+	for ( slot = h & (headers.slot_count - 1); headers.slots[slot] != 0;
+	      slot = (slot + 1) & (headers.slot_count - 1) )
+		;
+	headers.slots[slot] = id + 1;
+
+	return id;
+}
+
+/*
+ * FUNCTION
+ *	void free_headers(void)
+ * DESCRIPTION
+ *	frees the memory allocated for the header table
+ * PARAMETERS
+ *	None
+ * RETURN VALUE
+ *	None
+ */
+void free_headers(void)
+{
+	int n;
+
+	for ( n = 0; n < headers.count; n++ )
+	{
+		spill.used -= strlen(headers.list[n].name1)
+			+ strlen(headers.list[n].name2) + 2;
+		free(headers.list[n].name1);
+	}
+	spill.used -= headers.size * sizeof(struct header)
+		+ headers.slot_count * sizeof(int);
+	free(headers.list);
+	free(headers.slots);
+	memset(&headers, 0, sizeof(headers));
+}
+
+/*
+ * FUNCTION
+ *	char *intern_path(char file[])
+ * DESCRIPTION
+ *	Finds a source code file name in the path table, adding it if it is
+ *	new.
+ * PARAMETERS
+ *	char file[] - name of the source code file
+ * RETURN VALUE
+ *	The interned name, owned by the path table
+ */
+char *intern_path(char file[])
+{
+	return find_path(file)->name;
+}
+
+/*
+ * FUNCTION
+ *	struct path *find_path(char file[])
+ * DESCRIPTION
+ *	Finds the entry of a source code file name in the path table, adding
+ *	it if it is new. The hash table is doubled when it is half full.
+ * PARAMETERS
+ *	char file[] - name of the source code file
+ * RETURN VALUE
+ *	The entry of the name
+ */
+struct path *find_path(char file[])
+{
+	unsigned long h = 2166136261UL;
+	struct path *path;
+	size_t len;
+	char *p;
+	int slot, id, n;
+
+	for ( p = file; *p; p++ )
+		h = (h ^ (unsigned char)*p) * 16777619UL;
+	h &= 0xffffffffUL;
+
+	if ( paths.slot_count != 0 )
+		for ( slot = h & (paths.slot_count - 1); paths.slots[slot] != 0;
+		      slot = (slot + 1) & (paths.slot_count - 1) )
+		{
+			path = &paths.list[paths.slots[slot] - 1];
+			if ( path->hash == h && strcmp(path->name, file) == 0 )
+				return path;
+		}
+
+	/* a new name: grow the list and the hash table as needed */
+	if ( paths.count == paths.size )
+	{
+		spill.used += (paths.size ? paths.size : 64) * sizeof(struct path);
+		paths.size = paths.size ? paths.size * 2 : 64;
+		paths.list = realloc(paths.list, paths.size * sizeof(struct path));
+		if ( paths.list == NULL )
+		{
+			fprintf(stderr, "Out of space\n");
+			exit(1);
+		}
+	}
+	if ( 2 * (paths.count + 1) > paths.slot_count )
+	{
+		free(paths.slots);
+		spill.used += (paths.slot_count ? paths.slot_count : 128) * sizeof(int);
+		paths.slot_count = paths.slot_count ? paths.slot_count * 2 : 128;
+		paths.slots = calloc(paths.slot_count, sizeof(int));
+		if ( paths.slots == NULL )
+		{
+			fprintf(stderr, "Out of space\n");
+			exit(1);
+		}
+		for ( n = 0; n < paths.count; n++ )
+		{
+			for ( slot = paths.list[n].hash & (paths.slot_count - 1);
+			      paths.slots[slot] != 0;
+			      slot = (slot + 1) & (paths.slot_count - 1) )
+				;
+			paths.slots[slot] = n + 1;
+		}
+	}
+
+	id = paths.count++;
+	path = &paths.list[id];
+	len = strlen(file);
+	path->name = malloc(len + 1);
+	if ( path->name == NULL )
+	{
+		fprintf(stderr, "Out of space\n");
+		exit(1);
+	}
+	memcpy(path->name, file, len + 1);
+	spill.used += len + 1;
+	path->hash = h;
+	path->offset = 0;
+
+	for ( slot = h & (paths.slot_count - 1); paths.slots[slot] != 0;
+	      slot = (slot + 1) & (paths.slot_count - 1) )
+		;
+	paths.slots[slot] = id + 1;
+
+	return path;
+}
+
+/*
+ * FUNCTION
+ *	void free_paths(void)
+ * DESCRIPTION
+ *	frees the memory allocated for the path table
+ * PARAMETERS
+ *	None
+ * RETURN VALUE
+ *	None
+ */
+void free_paths(void)
+{
+	int n;
+
+	for ( n = 0; n < paths.count; n++ )
+	{
+		spill.used -= strlen(paths.list[n].name) + 1;
+		free(paths.list[n].name);
+	}
+	spill.used -= paths.size * sizeof(struct path)
+		+ paths.slot_count * sizeof(int);
+	free(paths.list);
+	free(paths.slots);
+	memset(&paths, 0, sizeof(paths));
+}
+
+/*
+ * FUNCTION
+ *	void delete_list(node *head)
+ * DESCRIPTION
+ *	frees the memory allocated for the list
+ * PARAMETERS
+ *	node *head - the head of the linked list
+ * RETURN VALUE
+ *	None
+ */
+node *free_list(node *head)
+{
+	node *tmpPtr = head;
+	node *followPtr;
+
+	while ( tmpPtr != NULL )
+	{
+		followPtr = tmpPtr;
+		tmpPtr = tmpPtr->next;
+		free(followPtr);
+		spill.used -= sizeof(node);
+	}
+	return NULL;
+}
+
+/*
+ * FUNCTION
+ *	struct file_data *insert_file(char file[])
+ * DESCRIPTION
+ *	Adds a record with zero totals for a source code file to the end of
+ *	the list of files.
+ * PARAMETERS
+ *	char file[] - name of the source code file
+ * RETURN VALUE
+ *	The new file record, exits if out of memory
+ */
+struct file_data *insert_file(char file[])
+{
+	struct file_data *current;
+
+	current = calloc(1, sizeof(struct file_data));
+	if ( current == NULL )
+	{
+		fprintf(stderr, "Out of space\n");
+		exit(1);
+	}
+
+	current->file = intern_path(file);
+	spill.used += sizeof(struct file_data);
+	if ( files == NULL )
+		files = current;
+	else
+		last_file->next = current;
+	last_file = current;
+
+	return current;
+}
+
+/*
+ * FUNCTION
+ *	struct file_data *free_files(struct file_data *files)
+ * DESCRIPTION
+ *	frees the memory allocated for the list of files
+ * PARAMETERS
+ *	struct file_data *files - the head of the list of files
+ * RETURN VALUE
+ *	NULL
+ */
+struct file_data *free_files(struct file_data *files)
+{
+	struct file_data *followPtr;
+
+	while ( files != NULL )
+	{
+		followPtr = files;
+		files = files->next;
+		free(followPtr);
+		spill.used -= sizeof(struct file_data);
+	}
+	last_file = NULL;
+	return NULL;
+}
+
+/*
+ * FUNCTION
+ *	void fn_key(char key[], char fn_name1[], char fn_name2[])
+ * DESCRIPTION
+ *	Extracts the function name from a function header, i.e. the identifier
+ *	immediately before the first '('. If the header has no parameter list
+ *	the first line of the header is used as the key.
+ * PARAMETERS
+ *	char key[] - receives the function name (BUF_LEN characters)
+ *	char fn_name1[] - first line of the function header
+ *	char fn_name2[] - second line of the function header, if any
+ * RETURN VALUE
+ *	None
+ */
+void fn_key(char key[], char fn_name1[], char fn_name2[])
+{
+	char *name = fn_name1;
+	char *paren;
+	char *end;
+	char *start;
+
+	paren = strchr(fn_name1, '(');
+	if ( paren == NULL && (paren = strchr(fn_name2, '(')) != NULL )
+		name = fn_name2;
+
+	if ( paren == NULL )
+	{
+		/* no parameter list, use the trimmed header */
+		end = fn_name1 + strcspn(fn_name1, "\r\n");
+		start = fn_name1;
+	}
+	else
+	{
+		end = paren;
+		while ( end > name && isspace((unsigned char)end[-1]) )
+			end--;
+		start = end;
+		while ( start > name && (isalnum((unsigned char)start[-1])
+			|| start[-1] == '_' || start[-1] == ':' || start[-1] == '~') )
+			start--;
+	}
+
+	if ( end - start >= BUF_LEN )
+		end = start + BUF_LEN - 1;
+	memcpy(key, start, end - start);
+	key[end - start] = '\0';
+}
+
+/*
+ * FUNCTION
+ *	int compare_idx_entry(const void *a, const void *b)
+ * DESCRIPTION
+ *	qsort() comparison for index records: by key, then file, then
+ *	starting line.
+ * PARAMETERS
+ *	const void *a, *b - pointers to the struct idx_entry records to compare
+ * RETURN VALUE
+ *	Less than, equal to or greater than zero, as for strcmp()
+ */
+int compare_idx_entry(const void *a, const void *b)
+{
+	const struct idx_entry *ea = a;
+	const struct idx_entry *eb = b;
+	int cmp;
+
+	cmp = strcmp(ea->key, eb->key);
+	if ( cmp == 0 )
+		cmp = strcmp(ea->file, eb->file);
+	if ( cmp == 0 )
+		cmp = ea->rec.start_line - eb->rec.start_line;
+	return cmp;
+}
+
+/*
+ * FUNCTION
+ *	int compare_idx_loc(const void *a, const void *b)
+ * DESCRIPTION
+ *	qsort() comparison for the LOC section of the index: largest LOC
+ *	first, then in key order.
+ * PARAMETERS
+ *	const void *a, *b - pointers to the struct idx_loc entries to compare
+ * RETURN VALUE
+ *	Less than, equal to or greater than zero as a sorts before, with or
+ *	after b
+ */
+int compare_idx_loc(const void *a, const void *b)
+{
+	const struct idx_loc *la = a;
+	const struct idx_loc *lb = b;
+
+	if ( la->loc != lb->loc )
+		return lb->loc - la->loc;
+	return la->rec - lb->rec;
+}
+
+/*
+ * FUNCTION
+ *	void write_index(char index_file[])
+ * DESCRIPTION
+ *	Writes the functions in the linked list to a sorted, fixed record
+ *	function index file that can be queried with --find and --over
+ *	without rescanning the source code. Runs spilled under --max-memory
+ *	are merged with the list as the records are written. The names go
+ *	to a temporary string table that is copied to the end of the index,
+ *	each file name only once, and the header, which holds its size, is
+ *	written last. An index that cannot be written in full is removed.
+ * PARAMETERS
+ *	char index_file[] - name of the index file to create
+ * RETURN VALUE
+ *	None, exits on error
+ */
+void write_index(char index_file[])
+{
+	struct idx_header hdr;
+	struct idx_entry *entries;	/* the next record of each run and the list */
+	struct run_reader *runs;	/* the spilled runs being merged */
+	struct idx_rec *rec;
+	struct idx_loc *by_loc;
+	int *live;		/* the run still has a record in entries */
+	struct idx_file_entry fentry;
+	struct file_data *file;
+	node **fns;
+	FILE *ip;
+	FILE *sp;		/* the string table */
+	char block[BLOCK_LEN];
+	size_t got;
+	int count;
+	int file_count = 0;
+	int written = 0;
+	int next = 0;		/* next function of the list to merge */
+	int n, min;
+
+	fns = sort_list(&count);
+	for ( file = files; file != NULL; file = file->next )
+		file_count++;
+
+	entries = calloc(spill.run_count + 1, sizeof(struct idx_entry));
+	runs = calloc(spill.run_count + 1, sizeof(struct run_reader));
+	live = calloc(spill.run_count + 1, sizeof(int));
+	by_loc = malloc((spill.fn_records + count + 1) * sizeof(struct idx_loc));
+	if ( entries == NULL || runs == NULL || live == NULL || by_loc == NULL )
+	{
+		fprintf(stderr, "Out of space\n");
+		exit(1);
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, IDX_MAGIC, sizeof(hdr.magic));
+	hdr.rec_size = IDX_REC_SIZE;
+	hdr.count = spill.fn_records + count;
+	hdr.file_rec_size = IDX_FILE_SIZE;
+	hdr.file_count = spill.file_count + file_count;
+	hdr.loc_pos = IDX_HEADER_SIZE + (int64_t)hdr.count * IDX_REC_SIZE;
+	hdr.file_pos = hdr.loc_pos + (int64_t)hdr.count * IDX_LOC_SIZE;
+	hdr.str_pos = hdr.file_pos + (int64_t)hdr.file_count * IDX_FILE_SIZE;
+
+	ip = fopen(index_file, "wb");
+	if ( ip == NULL )
+	{
+		fprintf(stderr, "Cannot create %s\n", index_file);
+		exit(1);
+	}
+	sp = tmpfile();
+	if ( sp == NULL )
+	{
+		fprintf(stderr, "Cannot create temporary file\n");
+		exit(1);
+	}
+	write_idx_str(sp, &hdr.str_size, "");
+	for ( n = 0; n < paths.count; n++ )
+		paths.list[n].offset = 0;
+	if ( !write_idx_header(ip, &hdr) )
+		index_write_error(ip, index_file);
+
+	/* the list is the last run */
+	for ( n = 0; n < spill.run_count; n++ )
+	{
+		runs[n].next = spill.run_start[n];
+		runs[n].end = n + 1 < spill.run_count ? spill.run_start[n + 1] : spill.fn_records;
+		live[n] = read_run(&runs[n], &entries[n]);
+	}
+	if ( next < count )
+	{
+		make_idx_entry(&entries[n], fns[next++]);
+		live[n] = 1;
+	}
+
+	for ( ;; )
+	{
+		min = -1;
+		for ( n = 0; n <= spill.run_count; n++ )
+			if ( live[n] && (min < 0 || compare_idx_entry(&entries[n], &entries[min]) < 0) )
+				min = n;
+		if ( min < 0 )
+			break;
+
+		rec = &entries[min].rec;
+		rec->key = write_idx_str(sp, &hdr.str_size, entries[min].key);
+		rec->name1 = write_idx_str(sp, &hdr.str_size, entries[min].name1);
+		rec->name2 = write_idx_str(sp, &hdr.str_size, entries[min].name2);
+		rec->file = write_idx_path(sp, &hdr.str_size, entries[min].file);
+		if ( !write_idx_rec(ip, rec) )
+			index_write_error(ip, index_file);
+		by_loc[written].loc = rec->loc;
+		by_loc[written].rec = written;
+		written++;
+
+		if ( min < spill.run_count )
+			live[min] = read_run(&runs[min], &entries[min]);
+		else if ( next < count )
+			make_idx_entry(&entries[min], fns[next++]);
+		else
+			live[min] = 0;
+	}
+
+	qsort(by_loc, written, sizeof(struct idx_loc), compare_idx_loc);
+	for ( n = 0; n < written; n++ )
+		if ( !write_idx_loc(ip, &by_loc[n]) )
+			index_write_error(ip, index_file);
+
+	if ( spill.files != NULL )
+	{
+		rewind(spill.files);
+		while ( fread(&fentry, sizeof(fentry), 1, spill.files) == 1 )
+		{
+			fentry.rec.file = write_idx_path(sp, &hdr.str_size, fentry.file);
+			if ( !write_idx_file(ip, &fentry.rec) )
+				index_write_error(ip, index_file);
+		}
+	}
+	for ( file = files; file != NULL; file = file->next )
+	{
+		make_idx_file(&fentry, file);
+		fentry.rec.file = write_idx_path(sp, &hdr.str_size, fentry.file);
+		if ( !write_idx_file(ip, &fentry.rec) )
+			index_write_error(ip, index_file);
+	}
+
+	rewind(sp);
+	while ( (got = fread(block, 1, sizeof(block), sp)) > 0 )
+		if ( fwrite(block, 1, got, ip) != got )
+			index_write_error(ip, index_file);
+	if ( ferror(sp) )
+	{
+		fclose(ip);
+		remove(index_file);
+		fprintf(stderr, "Cannot read temporary file\n");
+		exit(1);
+	}
+	rewind(ip);
+	if ( !write_idx_header(ip, &hdr) || ferror(ip) )
+		index_write_error(ip, index_file);
+	if ( fclose(ip) != 0 )
+	{
+		remove(index_file);
+		fprintf(stderr, "Cannot write %s\n", index_file);
+		exit(1);
+	}
+	fclose(sp);
+	free(entries);
+	free(runs);
+	free(live);
+	free(by_loc);
+	free(fns);
+}
+
+/*
+ * FUNCTION
+ *	int64_t write_idx_str(FILE *sp, int64_t *size, char str[])
+ * DESCRIPTION
+ *	Appends a name to the string table of an index being written. Every
+ *	empty name shares the empty string at the start of the table.
+ * PARAMETERS
+ *	FILE *sp - the string table
+ *	int64_t *size - bytes in the table, updated
+ *	char str[] - the name
+ * RETURN VALUE
+ *	Offset of the name in the table
+ */
+int64_t write_idx_str(FILE *sp, int64_t *size, char str[])
+{
+	int64_t offset = *size;
+	size_t len = strlen(str) + 1;
+
+	if ( str[0] == '\0' && offset > 0 )
+		return 0;
+	if ( fwrite(str, 1, len, sp) != len )
+	{
+		fprintf(stderr, "Cannot write temporary file\n");
+		exit(1);
+	}
+	*size += len;
+	return offset;
+}
+
+/*
+ * FUNCTION
+ *	int64_t write_idx_path(FILE *sp, int64_t *size, char file[])
+ * DESCRIPTION
+ *	Appends a source code file name to the string table of an index
+ *	being written the first time it is seen. The offset is kept in the
+ *	path table, so the records of later functions and of the file share
+ *	the same copy.
+ * PARAMETERS
+ *	FILE *sp - the string table
+ *	int64_t *size - bytes in the table, updated
+ *	char file[] - name of the source code file
+ * RETURN VALUE
+ *	Offset of the name in the table
+ */
+int64_t write_idx_path(FILE *sp, int64_t *size, char file[])
+{
+	struct path *path;
+
+	if ( file[0] == '\0' )
+		return 0;
+	path = find_path(file);
+	if ( path->offset == 0 )
+		path->offset = write_idx_str(sp, size, file);
+	return path->offset;
+}
+
+/*
+ * FUNCTION
+ *	void index_write_error(FILE *ip, char index_file[])
+ * DESCRIPTION
+ *	Removes an index file that could not be written in full, so a
+ *	truncated index is never left behind, and exits.
+ * PARAMETERS
+ *	FILE *ip - the index
+ *	char index_file[] - name of the index file
+ * RETURN VALUE
+ *	None, does not return
+ */
+void index_write_error(FILE *ip, char index_file[])
+{
+	fclose(ip);
+	remove(index_file);
+	fprintf(stderr, "Cannot write %s\n", index_file);
+	exit(1);
+}
+
+/*
+ * FUNCTION
+ *	void put_le(unsigned char buf[], int64_t value, int size)
+ * DESCRIPTION
+ *	Stores an integer in size bytes, least significant byte first, as
+ *	every field of a function index is stored.
+ * PARAMETERS
+ *	unsigned char buf[] - receives the bytes
+ *	int64_t value - the integer
+ *	int size - 4 or 8
+ * RETURN VALUE
+ *	None
+ */
+void put_le(unsigned char buf[], int64_t value, int size)
+{
+	uint64_t v = (uint64_t)value;
+	int n;
+
+	for ( n = 0; n < size; n++, v >>= 8 )
+		buf[n] = (unsigned char)(v & 0xff);
+}
+
+/*
+ * FUNCTION
+ *	int64_t get_le(unsigned char buf[], int size)
+ * DESCRIPTION
+ *	Reads a signed integer stored by put_le().
+ * PARAMETERS
+ *	unsigned char buf[] - the bytes
+ *	int size - 4 or 8
+ * RETURN VALUE
+ *	The integer
+ */
+int64_t get_le(unsigned char buf[], int size)
+{
+	uint64_t v = 0;
+	int n;
+
+	for ( n = size - 1; n >= 0; n-- )
+		v = (v << 8) | buf[n];
+	if ( size < 8 && (v >> (8 * size - 1)) != 0 )
+		v |= ~(uint64_t)0 << (8 * size);
+	return (int64_t)v;
+}
+
+/*
+ * FUNCTION
+ *	int write_idx_header(FILE *ip, struct idx_header *hdr)
+ * DESCRIPTION
+ *	Writes the header of a function index in its file layout.
+ * PARAMETERS
+ *	FILE *ip - the index
+ *	struct idx_header *hdr - the header
+ * RETURN VALUE
+ *	1 on success, 0 if it could not be written
+ */
+int write_idx_header(FILE *ip, struct idx_header *hdr)
+{
+	unsigned char buf[IDX_HEADER_SIZE];
+
+	memcpy(buf, hdr->magic, 8);
+	put_le(buf + 8, hdr->rec_size, 4);
+	put_le(buf + 12, hdr->count, 4);
+	put_le(buf + 16, hdr->file_rec_size, 4);
+	put_le(buf + 20, hdr->file_count, 4);
+	put_le(buf + 24, hdr->loc_pos, 8);
+	put_le(buf + 32, hdr->file_pos, 8);
+	put_le(buf + 40, hdr->str_pos, 8);
+	put_le(buf + 48, hdr->str_size, 8);
+	return fwrite(buf, IDX_HEADER_SIZE, 1, ip) == 1;
+}
+
+/*
+ * FUNCTION
+ *	int read_idx_header(FILE *ip, struct idx_header *hdr)
+ * DESCRIPTION
+ *	Reads the header of a function index written by write_idx_header().
+ * PARAMETERS
+ *	FILE *ip - the index
+ *	struct idx_header *hdr - receives the header
+ * RETURN VALUE
+ *	1 on success, 0 if it could not be read
+ */
+int read_idx_header(FILE *ip, struct idx_header *hdr)
+{
+	unsigned char buf[IDX_HEADER_SIZE];
+
+	if ( fread(buf, IDX_HEADER_SIZE, 1, ip) != 1 )
+		return 0;
+	memcpy(hdr->magic, buf, 8);
+	hdr->rec_size = (int32_t)get_le(buf + 8, 4);
+	hdr->count = (int32_t)get_le(buf + 12, 4);
+	hdr->file_rec_size = (int32_t)get_le(buf + 16, 4);
+	hdr->file_count = (int32_t)get_le(buf + 20, 4);
+	hdr->loc_pos = get_le(buf + 24, 8);
+	hdr->file_pos = get_le(buf + 32, 8);
+	hdr->str_pos = get_le(buf + 40, 8);
+	hdr->str_size = get_le(buf + 48, 8);
+	return 1;
+}
+
+/*
+ * FUNCTION
+ *	int write_idx_rec(FILE *ip, struct idx_rec *rec)
+ * DESCRIPTION
+ *	Writes a function record of an index in its file layout.
+ * PARAMETERS
+ *	FILE *ip - the index
+ *	struct idx_rec *rec - the record
+ * RETURN VALUE
+ *	1 on success, 0 if it could not be written
+ */
+int write_idx_rec(FILE *ip, struct idx_rec *rec)
+{
+	unsigned char buf[IDX_REC_SIZE];
+
+	put_le(buf, rec->key, 8);
+	put_le(buf + 8, rec->name1, 8);
+	put_le(buf + 16, rec->name2, 8);
+	put_le(buf + 24, rec->file, 8);
+	put_le(buf + 32, rec->start_offset, 8);
+	put_le(buf + 40, rec->end_offset, 8);
+	put_le(buf + 48, rec->start_line, 4);
+	put_le(buf + 52, rec->end_line, 4);
+	put_le(buf + 56, rec->loc, 4);
+	put_le(buf + 60, rec->branches, 4);
+	put_le(buf + 64, rec->depth, 4);
+	put_le(buf + 68, rec->returns, 4);
+	return fwrite(buf, IDX_REC_SIZE, 1, ip) == 1;
+}
+
+/*
+ * FUNCTION
+ *	int read_idx_rec(FILE *ip, struct idx_rec *rec)
+ * DESCRIPTION
+ *	Reads a function record written by write_idx_rec().
+ * PARAMETERS
+ *	FILE *ip - the index
+ *	struct idx_rec *rec - receives the record
+ * RETURN VALUE
+ *	1 on success, 0 if it could not be read
+ */
+int read_idx_rec(FILE *ip, struct idx_rec *rec)
+{
+	unsigned char buf[IDX_REC_SIZE];
+
+	if ( fread(buf, IDX_REC_SIZE, 1, ip) != 1 )
+		return 0;
+	rec->key = get_le(buf, 8);
+	rec->name1 = get_le(buf + 8, 8);
+	rec->name2 = get_le(buf + 16, 8);
+	rec->file = get_le(buf + 24, 8);
+	rec->start_offset = get_le(buf + 32, 8);
+	rec->end_offset = get_le(buf + 40, 8);
+	rec->start_line = (int32_t)get_le(buf + 48, 4);
+	rec->end_line = (int32_t)get_le(buf + 52, 4);
+	rec->loc = (int32_t)get_le(buf + 56, 4);
+	rec->branches = (int32_t)get_le(buf + 60, 4);
+	rec->depth = (int32_t)get_le(buf + 64, 4);
+	rec->returns = (int32_t)get_le(buf + 68, 4);
+	return 1;
+}
+
+/*
+ * FUNCTION
+ *	int write_idx_loc(FILE *ip, struct idx_loc *loc)
+ * DESCRIPTION
+ *	Writes an entry of the LOC section of an index in its file layout.
+ * PARAMETERS
+ *	FILE *ip - the index
+ *	struct idx_loc *loc - the entry
+ * RETURN VALUE
+ *	1 on success, 0 if it could not be written
+ */
+int write_idx_loc(FILE *ip, struct idx_loc *loc)
+{
+	unsigned char buf[IDX_LOC_SIZE];
+
+	put_le(buf, loc->loc, 4);
+	put_le(buf + 4, loc->rec, 4);
+	return fwrite(buf, IDX_LOC_SIZE, 1, ip) == 1;
+}
+
+/*
+ * FUNCTION
+ *	int read_idx_loc(FILE *ip, struct idx_loc *loc)
+ * DESCRIPTION
+ *	Reads an entry of the LOC section written by write_idx_loc().
+ * PARAMETERS
+ *	FILE *ip - the index
+ *	struct idx_loc *loc - receives the entry
+ * RETURN VALUE
+ *	1 on success, 0 if it could not be read
+ */
+int read_idx_loc(FILE *ip, struct idx_loc *loc)
+{
+	unsigned char buf[IDX_LOC_SIZE];
+
+	if ( fread(buf, IDX_LOC_SIZE, 1, ip) != 1 )
+		return 0;
+	loc->loc = (int32_t)get_le(buf, 4);
+	loc->rec = (int32_t)get_le(buf + 4, 4);
+	return 1;
+}
+
+/*
+ * FUNCTION
+ *	int write_idx_file(FILE *ip, struct idx_file *frec)
+ * DESCRIPTION
+ *	Writes a file record of an index in its file layout.
+ * PARAMETERS
+ *	FILE *ip - the index
+ *	struct idx_file *frec - the record
+ * RETURN VALUE
+ *	1 on success, 0 if it could not be written
+ */
+int write_idx_file(FILE *ip, struct idx_file *frec)
+{
+	unsigned char buf[IDX_FILE_SIZE];
+
+	put_le(buf, frec->file, 8);
+	put_le(buf + 8, frec->seq, 4);
+	put_le(buf + 12, frec->prg_loc, 4);
+	put_le(buf + 16, frec->fn_count, 4);
+	put_le(buf + 20, frec->fn_loc, 4);
+	put_le(buf + 24, frec->kind, 4);
+	put_le(buf + 28, frec->skipped, 4);
+	put_le(buf + 32, frec->dead_loc, 4);
+	return fwrite(buf, IDX_FILE_SIZE, 1, ip) == 1;
+}
+
+/*
+ * FUNCTION
+ *	int read_idx_file(FILE *ip, struct idx_file *frec)
+ * DESCRIPTION
+ *	Reads a file record written by write_idx_file().
+ * PARAMETERS
+ *	FILE *ip - the index
+ *	struct idx_file *frec - receives the record
+ * RETURN VALUE
+ *	1 on success, 0 if it could not be read
+ */
+int read_idx_file(FILE *ip, struct idx_file *frec)
+{
+	unsigned char buf[IDX_FILE_SIZE];
+
+	if ( fread(buf, IDX_FILE_SIZE, 1, ip) != 1 )
+		return 0;
+	frec->file = get_le(buf, 8);
+	frec->seq = (int32_t)get_le(buf + 8, 4);
+	frec->prg_loc = (int32_t)get_le(buf + 12, 4);
+	frec->fn_count = (int32_t)get_le(buf + 16, 4);
+	frec->fn_loc = (int32_t)get_le(buf + 20, 4);
+	frec->kind = (int32_t)get_le(buf + 24, 4);
+	frec->skipped = (int32_t)get_le(buf + 28, 4);
+	frec->dead_loc = (int32_t)get_le(buf + 32, 4);
+	return 1;
+}
+
+/*
+ * FUNCTION
+ *	void make_idx_entry(struct idx_entry *entry, node *fn)
+ * DESCRIPTION
+ *	Fills in the function index record for a function in the list, with
+ *	its names. The string table offsets are set when it is written.
+ * PARAMETERS
+ *	struct idx_entry *entry - the record to fill in
+ *	node *fn - the function
+ * RETURN VALUE
+ *	None
+ */
+void make_idx_entry(struct idx_entry *entry, node *fn)
+{
+	memset(entry, 0, sizeof(*entry));
+	fn_key(entry->key, fn->name1, fn->name2);
+	strncpy(entry->name1, fn->name1, BUF_LEN - 1);
+	strncpy(entry->name2, fn->name2, BUF_LEN - 1);
+	strncpy(entry->file, fn->file, PATH_LEN - 1);
+	entry->rec.start_line = fn->pos.start_line;
+	entry->rec.end_line = fn->pos.end_line;
+	entry->rec.start_offset = fn->pos.start_offset;
+	entry->rec.end_offset = fn->pos.end_offset;
+	entry->rec.loc = fn->loc;
+	entry->rec.branches = fn->metrics.branches;
+	entry->rec.depth = fn->metrics.depth;
+	entry->rec.returns = fn->metrics.returns;
+}
+
+/*
+ * FUNCTION
+ *	void make_idx_file(struct idx_file_entry *fentry, struct file_data *file)
+ * DESCRIPTION
+ *	Fills in the function index record for a file in the list of files.
+ * PARAMETERS
+ *	struct idx_file_entry *fentry - the record to fill in
+ *	struct file_data *file - the file
+ * RETURN VALUE
+ *	None
+ */
+void make_idx_file(struct idx_file_entry *fentry, struct file_data *file)
+{
+	memset(fentry, 0, sizeof(*fentry));
+	strncpy(fentry->file, file->file, PATH_LEN - 1);
+	fentry->rec.seq = file->seq;
+	fentry->rec.prg_loc = file->prg_loc;
+	fentry->rec.fn_count = file->fn_count;
+	fentry->rec.fn_loc = file->fn_loc;
+	fentry->rec.kind = file->kind;
+	fentry->rec.skipped = file->skipped;
+	fentry->rec.dead_loc = file->dead_loc;
+}
+
+/*
+ * FUNCTION
+ *	node **sort_list(int *count)
+ * DESCRIPTION
+ *	Sorts pointers to the functions in the list into function index
+ *	order. Only the pointers are allocated, so a list near --max-memory
+ *	can still be sorted.
+ * PARAMETERS
+ *	int *count - receives the number of functions
+ * RETURN VALUE
+ *	The sorted pointers, to be freed by the caller
+ */
+node **sort_list(int *count)
+{
+	node **fns;
+	node *current;
+	int n = 0;
+
+	for ( current = head; current != NULL; current = current->next )
+		n++;
+	fns = malloc((n ? n : 1) * sizeof(node *));
+	if ( fns == NULL )
+	{
+		fprintf(stderr, "Out of space\n");
+		exit(1);
+	}
+	for ( n = 0, current = head; current != NULL; current = current->next )
+		fns[n++] = current;
+	qsort(fns, n, sizeof(node *), compare_fn_ptr);
+
+	*count = n;
+	return fns;
+}
+
+/*
+ * FUNCTION
+ *	int compare_fn_ptr(const void *a, const void *b)
+ * DESCRIPTION
+ *	qsort() comparison for pointers to functions in the list, in the same
+ *	order as compare_idx_entry().
+ * PARAMETERS
+ *	const void *a, *b - pointers to the node pointers to compare
+ * RETURN VALUE
+ *	Less than, equal to or greater than zero, as for strcmp()
+ */
+int compare_fn_ptr(const void *a, const void *b)
+{
+	node *fa = *(node * const *)a;
+	node *fb = *(node * const *)b;
+	char key_a[BUF_LEN], key_b[BUF_LEN];
+	int cmp;
+
+	fn_key(key_a, fa->name1, fa->name2);
+	fn_key(key_b, fb->name1, fb->name2);
+	cmp = strcmp(key_a, key_b);
+	if ( cmp == 0 )
+		cmp = strcmp(fa->file, fb->file);
+	if ( cmp == 0 )
+		cmp = fa->pos.start_line - fb->pos.start_line;
+	return cmp;
+}
+
+/*
+ * FUNCTION
+ *	int count_units(struct name_list *names)
+ * DESCRIPTION
+ *	Counts translation units: each source code file named and the headers
+ *	it reaches through #include lines, found in the directory of the
+ *	including file ("" only) and in the -I directories. Every file is
+ *	counted and displayed once, however many units reach it. Then the
+ *	totals of each unit are displayed with the headers shared by several
+ *	units shown separately, followed by the shared headers and the
+ *	combined summary of all the files.
+ * PARAMETERS
+ *	struct name_list *names - the translation units
+ * RETURN VALUE
+ *	0 if every unit was counted, 1 if a unit could not be opened
+ */
+int count_units(struct name_list *names)
+{
+	struct trans_unit *tus;
+	struct unit_file *u;
+	char path[PATH_LEN];
+	int status = 0;
+	int shared = 0;
+	int n;
+
+	tus = calloc(names->count, sizeof(struct trans_unit));
+	if ( tus == NULL )
+	{
+		fprintf(stderr, "Out of space\n");
+		exit(1);
+	}
+
+	start_progress(names);
+	for ( n = 0; n < names->count; n++ )
+	{
+		if ( !in_shard(names->names[n]) )
+			continue;
+		strncpy(path, names->names[n], PATH_LEN - 1);
+		path[PATH_LEN - 1] = '\0';
+		clean_path(path);
+		if ( !reach_unit(find_unit(path), n, &tus[n]) )
+			status = 1;
+	}
+	show_progress(1);
+
+	for ( n = 0; n < names->count; n++ )
+		if ( tus[n].count > 0 )
+			print_unit(names->names[n], &tus[n]);
+
+	for ( n = 0; n < units.count; n++ )
+	{
+		u = &units.list[n];
+		if ( u->tu_count < 2 )
+			continue;
+		if ( shared++ == 0 )
+			printf("Shared headers:\n  LOC  Units  File\n");
+		printf("%5d  %5d  %s\n", u->prg_loc, u->tu_count, u->file);
+	}
+	if ( shared != 0 )
+		printf("\n");
+
+	if ( units.counted > 1 )
+		print_totals();
+	if ( opts.index_file != NULL )
+		write_index(opts.index_file);
+	update_metrics(1);
+
+	for ( n = 0; n < names->count; n++ )
+		free(tus[n].files);
+	free(tus);
+	free_units();
+
+	return status;
+}
+
+/*
+ * FUNCTION
+ *	int reach_unit(int id, int tu, struct trans_unit *unit)
+ * DESCRIPTION
+ *	Finds the files reached by a translation unit, counting those that
+ *	have not been counted yet, and adds them to the unit.
+ * PARAMETERS
+ *	int id - the unit of the translation unit's source code file
+ *	int tu - number of the translation unit
+ *	struct trans_unit *unit - receives the files reached
+ * RETURN VALUE
+ *	0 if the translation unit's source code file could not be opened
+ */
+int reach_unit(int id, int tu, struct trans_unit *unit)
+{
+	int *stack = NULL;
+	int depth = 0;
+	int size = 0;
+	int n;
+
+	if ( !units.list[id].counted )
+		count_unit(id);
+	if ( units.list[id].mark == -1 )
+		return 0;
+
+	for ( ;; )
+	{
+		if ( units.list[id].mark != tu + 1 )
+		{
+			units.list[id].mark = tu + 1;
+			units.list[id].tu_count++;
+			if ( unit->count % 64 == 0 )
+				unit->files = realloc(unit->files, (unit->count + 64) * sizeof(int));
+			if ( unit->files == NULL )
+			{
+				fprintf(stderr, "Out of space\n");
+				exit(1);
+			}
+			unit->files[unit->count++] = id;
+
+			if ( !units.list[id].counted )
+				count_unit(id);
+			if ( depth + units.list[id].include_count > size )
+			{
+				size = depth + units.list[id].include_count + 64;
+				stack = realloc(stack, size * sizeof(int));
+				if ( stack == NULL )
+				{
+					fprintf(stderr, "Out of space\n");
+					exit(1);
+				}
+			}
+			for ( n = units.list[id].include_count - 1; n >= 0; n-- )
+				stack[depth++] = units.list[id].includes[n];
+		}
+		if ( depth == 0 )
+			break;
+		id = stack[--depth];
+	}
+
+	free(stack);
+	return 1;
+}
+
+/*
+ * FUNCTION
+ *	void count_unit(int id)
+ * DESCRIPTION
+ *	Counts and displays a file of a translation unit, keeps its totals
+ *	and finds the headers named by its #include lines. A file that cannot
+ *	be opened is marked with -1.
+ * PARAMETERS
+ *	int id - the unit of the file
+ * RETURN VALUE
+ *	None
+ */
+void count_unit(int id)
+{
+	char file[PATH_LEN];
+	char path[PATH_LEN];
+	struct file_data *rec;
+	int inc;
+	int n;
+	double start;
+
+	strcpy(file, units.list[id].file);
+	units.list[id].counted = 1;
+	free_names(&found_includes);
+
+	start = wall_clock();
+	if ( !count_source(file, units.counted++ == 0) )
+	{
+		units.list[id].mark = -1;
+		return;
+	}
+	rec = last_file;
+	rec->seq = id;
+	units.list[id].prg_loc = rec->prg_loc;
+	units.list[id].fn_count = rec->fn_count;
+	units.list[id].fn_loc = rec->fn_loc;
+	progress.found = units.count;
+	file_progress(file, rec, wall_clock() - start);
+	check_memory();
+	update_metrics(0);
+
+	for ( n = 0; n < found_includes.count; n++ )
+	{
+		if ( !resolve_include(path, found_includes.names[n], file) )
+			continue;
+		inc = find_unit(path);
+		if ( units.list[id].include_count % 16 == 0 )
+			units.list[id].includes = realloc(units.list[id].includes,
+				(units.list[id].include_count + 16) * sizeof(int));
+		if ( units.list[id].includes == NULL )
+		{
+			fprintf(stderr, "Out of space\n");
+			exit(1);
+		}
+		units.list[id].includes[units.list[id].include_count++] = inc;
+	}
+	progress.found = units.count;
+	free_names(&found_includes);
+}
+
+/*
+ * FUNCTION
+ *	int find_unit(char file[])
+ * DESCRIPTION
+ *	Finds the unit of a file, adding a unit that has not been counted if
+ *	the file is new. The hash table is doubled when it is half full.
+ * PARAMETERS
+ *	char file[] - name of the file, as cleaned by clean_path()
+ * RETURN VALUE
+ *	The unit of the file
+ */
+int find_unit(char file[])
+{
+	unsigned long h = hash_path(file);
+	int slot, id, n;
+
+	if ( units.slot_count != 0 )
+		for ( slot = h & (units.slot_count - 1); units.slots[slot] != 0;
+		      slot = (slot + 1) & (units.slot_count - 1) )
+			if ( same_path(units.list[units.slots[slot] - 1].file, file) )
+				return units.slots[slot] - 1;
+
+	if ( units.count == units.size )
+	{
+		units.size = units.size ? units.size * 2 : 64;
+		units.list = realloc(units.list, units.size * sizeof(struct unit_file));
+		if ( units.list == NULL )
+		{
+			fprintf(stderr, "Out of space\n");
+			exit(1);
+		}
+	}
+	id = units.count++;
+	memset(&units.list[id], 0, sizeof(struct unit_file));
+	strncpy(units.list[id].file, file, PATH_LEN - 1);
+
+	if ( 2 * units.count > units.slot_count )
+	{
+		free(units.slots);
+		units.slot_count = units.slot_count ? units.slot_count * 2 : 128;
+		units.slots = calloc(units.slot_count, sizeof(int));
+		if ( units.slots == NULL )
+		{
+			fprintf(stderr, "Out of space\n");
+			exit(1);
+		}
+		for ( n = 0; n < units.count; n++ )
+		{
+			h = hash_path(units.list[n].file);
+			for ( slot = h & (units.slot_count - 1); units.slots[slot] != 0;
+			      slot = (slot + 1) & (units.slot_count - 1) )
+				;
+			units.slots[slot] = n + 1;
+		}
+	}
+	else
+	{
+		for ( slot = h & (units.slot_count - 1); units.slots[slot] != 0;
+		      slot = (slot + 1) & (units.slot_count - 1) )
+			;
+		units.slots[slot] = id + 1;
+	}
+
+	return id;
+}
+
+/*
+ * FUNCTION
+ *	unsigned long hash_path(char file[])
+ * DESCRIPTION
+ *	FNV-1a hash of a file name as cleaned by clean_path(). File names are
+ *	not case sensitive on Windows, so there the case is ignored.
+ * PARAMETERS
+ *	char file[] - name of the file
+ * RETURN VALUE
+ *	The 32 bit hash
+ */
+unsigned long hash_path(char file[])
+{
+	unsigned long h = 2166136261UL;
+	char *p;
+
+	for ( p = file; *p; p++ )
+#ifdef _WIN32
+		h = (h ^ (unsigned char)tolower((unsigned char)*p)) * 16777619UL;
+#else
+		h = (h ^ (unsigned char)*p) * 16777619UL;
+#endif
+
+	return h & 0xffffffffUL;
+}
+
+/*
+ * FUNCTION
+ *	int same_path(char a[], char b[])
+ * DESCRIPTION
+ *	Compares two file names as cleaned by clean_path(), ignoring case on
+ *	Windows.
+ * PARAMETERS
+ *	char a[], char b[] - the file names
+ * RETURN VALUE
+ *	1 if the names are of the same file, otherwise 0
+ */
+int same_path(char a[], char b[])
+{
+#ifdef _WIN32
+	return _stricmp(a, b) == 0;
+#else
+	return strcmp(a, b) == 0;
+#endif
+}
+
+/*
+ * FUNCTION
+ *	void note_include(char line[])
+ * DESCRIPTION
+ *	Adds the header named by an #include line to found_includes, as
+ *	"name for #include "name" and <name for #include <name>.
+ * PARAMETERS
+ *	char line[] - a line of source code outside comments
+ * RETURN VALUE
+ *	None
+ */
+void note_include(char line[])
+{
+	char name[BUF_LEN];
+	char *p = line + strspn(line, " \t");
+	char *end;
+
+	if ( *p++ != '#' )
+		return;
+	p += strspn(p, " \t");
+	if ( strncmp(p, "include", 7) != 0 )
+		return;
+	p += 7;
+	p += strspn(p, " \t");
+	if ( *p == '"' )
+		end = strchr(p + 1, '"');
+	else if ( *p == '<' )
+		end = strchr(p + 1, '>');
+	else
+		return;
+	if ( end == NULL || end == p + 1 )
+		return;
+
+	memcpy(name, p, end - p);
+	name[end - p] = '\0';
+	add_name(&found_includes, name);
+}
+
+/*
+ * FUNCTION
+ *	int resolve_include(char path[], char name[], char from[])
+ * DESCRIPTION
+ *	Finds the file of a header named by an #include line: a "name" in the
+ *	directory of the including file, then either kind in the -I
+ *	directories in the order given.
+ * PARAMETERS
+ *	char path[] - receives the cleaned name of the file (PATH_LEN)
+ *	char name[] - the header, "name or <name
+ *	char from[] - name of the including file
+ * RETURN VALUE
+ *	1 if the header was found, 0 if not
+ */
+int resolve_include(char path[], char name[], char from[])
+{
+	char *slash;
+	int fd;
+	int n;
+
+	for ( n = name[0] == '"' ? -1 : 0; n < opts.include_dirs.count; n++ )
+	{
+		if ( n < 0 )
+		{
+			slash = strrchr(from, '/');
+			if ( strrchr(from, '\\') > slash )
+				slash = strrchr(from, '\\');
+			if ( slash == NULL )
+				path[0] = '\0';
+			else if ( slash - from + strlen(name) < PATH_LEN )
+				sprintf(path, "%.*s", (int)(slash - from + 1), from);
+			else
+				continue;
+		}
+		else if ( strlen(opts.include_dirs.names[n]) + strlen(name) < PATH_LEN )
+			sprintf(path, "%s/", opts.include_dirs.names[n]);
+		else
+			continue;
+		strcat(path, name + 1);
+		clean_path(path);
+
+		fd = open(path, O_RDONLY | O_BINARY);
+		if ( fd >= 0 )
+		{
+			close(fd);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * FUNCTION
+ *	void clean_path(char path[])
+ * DESCRIPTION
+ *	Removes "." and "name/.." parts and repeated separators from a file
+ *	name and writes every '\\' as '/', so that a header reached by
+ *	different routes has one name.
+ * PARAMETERS
+ *	char path[] - the file name, changed in place
+ * RETURN VALUE
+ *	None
+ */
+void clean_path(char path[])
+{
+	char copy[PATH_LEN];
+	char *part[PATH_LEN / 2];
+	char *p;
+	int count = 0;
+	int n;
+
+	strcpy(copy, path);
+	for ( p = strtok(copy, "/\\"); p != NULL; p = strtok(NULL, "/\\") )
+	{
+		if ( strcmp(p, ".") == 0 )
+			continue;
+		if ( strcmp(p, "..") == 0 && count > 0 && strcmp(part[count - 1], "..") != 0 )
+			count--;
+		else
+			part[count++] = p;
+	}
+
+	strcpy(path, path[0] == '/' || path[0] == '\\' ? "/" : "");
+	for ( n = 0; n < count; n++ )
+	{
+		if ( n > 0 )
+			strcat(path, "/");
+		strcat(path, part[n]);
+	}
+	if ( path[0] == '\0' )
+		strcpy(path, ".");
+}
+
+/*
+ * FUNCTION
+ *	void print_unit(char file[], struct trans_unit *unit)
+ * DESCRIPTION
+ *	Displays the totals of a translation unit. The LOC of files reached
+ *	only by this unit and of headers shared with other units are shown
+ *	separately.
+ * PARAMETERS
+ *	char file[] - the translation unit's source code file
+ *	struct trans_unit *unit - the files it reaches
+ * RETURN VALUE
+ *	None
+ */
+void print_unit(char file[], struct trans_unit *unit)
+{
+	struct unit_file *u;
+	int fn_count = 0, fn_loc = 0, own_loc = 0, shared_loc = 0;
+	int shared = 0;
+	int n;
+
+	for ( n = 0; n < unit->count; n++ )
+	{
+		u = &units.list[unit->files[n]];
+		fn_count += u->fn_count;
+		fn_loc += u->fn_loc;
+		if ( u->tu_count > 1 )
+		{
+			shared++;
+			shared_loc += u->prg_loc;
+		}
+		else
+			own_loc += u->prg_loc;
+	}
+
+	printf("Translation unit %s:\n", file);
+	printf("Number of files:     %4d\n", unit->count);
+	printf("Shared headers:      %4d\n", shared);
+	printf("Number of functions: %4d\n", fn_count);
+	printf("Function LOC:        %4d\n", fn_loc);
+	printf("Own LOC:             %4d\n", own_loc);
+	printf("Shared header LOC:   %4d\n", shared_loc);
+	printf("Total Program LOC:   %4d\n\n", own_loc + shared_loc);
+}
+
+/*
+ * FUNCTION
+ *	void free_units(void)
+ * DESCRIPTION
+ *	frees the memory allocated for the translation unit files
+ * PARAMETERS
+ *	None
+ * RETURN VALUE
+ *	None
+ */
+void free_units(void)
+{
+	int n;
+
+	for ( n = 0; n < units.count; n++ )
+		free(units.list[n].includes);
+	free(units.list);
+	free(units.slots);
+	memset(&units, 0, sizeof(units));
+	free_names(&found_includes);
+}
+
+/*
+ * FUNCTION
+ *	long parse_size(char arg[])
+ * DESCRIPTION
+ *	Converts a size such as 512K, 64M or 2G to bytes.
+ * PARAMETERS
+ *	char arg[] - the size, a number with an optional K, M or G suffix
+ * RETURN VALUE
+ *	The number of bytes, 0 if the size is not valid
+ */
+long parse_size(char arg[])
+{
+	char *end;
+	double size;
+
+	size = strtod(arg, &end);
+	switch ( toupper((unsigned char)*end) )
+	{
+		case 'K':
+			size *= 1024.0;
+			end++;
+			break;
+		case 'M':
+			size *= 1024.0 * 1024.0;
+			end++;
+			break;
+		case 'G':
+			size *= 1024.0 * 1024.0 * 1024.0;
+			end++;
+			break;
+	}
+	if ( end == arg || *end != '\0' || size < 1.0 || size > 2147483647.0 )
+		return 0;
+	return (long)size;
+}
+
+/*
+ * FUNCTION
+ *	void check_memory(void)
+ * DESCRIPTION
+ *	Spills the results counted so far to temporary files once the lists
+ *	and the header and path tables reach three quarters of --max-memory,
+ *	leaving room for the next file. It is called between files, not from
+ *	count_file(), so the results of one file are never split and a file
+ *	with more functions than the last quarter holds goes over the limit
+ *	until it is spilled.
+ * PARAMETERS
+ *	None
+ * RETURN VALUE
+ *	None
+ */
+void check_memory(void)
+{
+	if ( opts.max_memory > 0 && spill.used >= opts.max_memory - opts.max_memory / 4 )
+		spill_results();
+}
+
+/*
+ * FUNCTION
+ *	void spill_results(void)
+ * DESCRIPTION
+ *	Writes the functions in the list as a new sorted run at the end of
+ *	the spilled runs, noting where it starts, and the files in the list
+ *	of files to the spilled file records, adding their totals to the
+ *	spilled totals, then frees both lists and the header and path tables.
+ * PARAMETERS
+ *	None
+ * RETURN VALUE
+ *	None, exits on error
+ */
+void spill_results(void)
+{
+	struct idx_entry entry;
+	struct idx_file_entry fentry;
+	struct file_data *file;
+	node **fns;
+	int count, n;
+
+	if ( head != NULL )
+	{
+		fns = sort_list(&count);
+		if ( spill.runs == NULL && (spill.runs = tmpfile()) == NULL )
+		{
+			fprintf(stderr, "Cannot create temporary file\n");
+			exit(1);
+		}
+		spill.run_start = realloc(spill.run_start, (spill.run_count + 1) * sizeof(long));
+		if ( spill.run_start == NULL )
+		{
+			fprintf(stderr, "Out of space\n");
+			exit(1);
+		}
+		spill.run_start[spill.run_count++] = spill.fn_records;
+		fseek(spill.runs, 0L, SEEK_END);
+		for ( n = 0; n < count; n++ )
+		{
+			make_idx_entry(&entry, fns[n]);
+			fwrite(&entry, sizeof(entry), 1, spill.runs);
+		}
+		if ( ferror(spill.runs) )
+		{
+			fprintf(stderr, "Cannot write temporary file\n");
+			exit(1);
+		}
+		spill.fn_records += count;
+		free(fns);
+		head = free_list(head);
+		last = NULL;
+	}
+
+	if ( files != NULL )
+	{
+		if ( spill.files == NULL && (spill.files = tmpfile()) == NULL )
+		{
+			fprintf(stderr, "Cannot create temporary file\n");
+			exit(1);
+		}
+		for ( file = files; file != NULL; file = file->next )
+		{
+			make_idx_file(&fentry, file);
+			fwrite(&fentry, sizeof(fentry), 1, spill.files);
+			spill.file_count++;
+			spill.fn_count += file->fn_count;
+			spill.fn_loc += file->fn_loc;
+			spill.prg_loc += file->prg_loc;
+			spill.skipped += file->skipped;
+			spill.dead_loc += file->dead_loc;
+			spill.over += file->over != WithinBudget;
+		}
+		if ( ferror(spill.files) )
+		{
+			fprintf(stderr, "Cannot write temporary file\n");
+			exit(1);
+		}
+		files = free_files(files);
+	}
+
+	free_headers();
+	free_paths();
+}
+
+/*
+ * FUNCTION
+ *	int read_run(struct run_reader *run, struct idx_entry *entry)
+ * DESCRIPTION
+ *	Reads the next record of a spilled run. The runs share one file, so
+ *	RUN_BLOCK records are read at each seek to the run.
+ * PARAMETERS
+ *	struct run_reader *run - the run
+ *	struct idx_entry *entry - receives the record
+ * RETURN VALUE
+ *	1 if a record was read, 0 at the end of the run; exits on error
+ */
+int read_run(struct run_reader *run, struct idx_entry *entry)
+{
+	long want;
+
+	if ( run->pos == run->got )
+	{
+		want = run->end - run->next < RUN_BLOCK ? run->end - run->next : RUN_BLOCK;
+		if ( want <= 0 )
+			return 0;
+		if ( fseek(spill.runs, run->next * (long)sizeof(struct idx_entry), SEEK_SET) != 0
+		     || fread(run->buf, sizeof(struct idx_entry), want, spill.runs) != (size_t)want )
+		{
+			fprintf(stderr, "Cannot read temporary file\n");
+			exit(1);
+		}
+		run->next += want;
+		run->got = want;
+		run->pos = 0;
+	}
+	*entry = run->buf[run->pos++];
+	return 1;
+}
+
+/*
+ * FUNCTION
+ *	void free_spill(void)
+ * DESCRIPTION
+ *	Closes, and so deletes, the temporary files of spilled results.
+ * PARAMETERS
+ *	None
+ * RETURN VALUE
+ *	None
+ */
+void free_spill(void)
+{
+	if ( spill.runs != NULL )
+		fclose(spill.runs);
+	free(spill.run_start);
+	if ( spill.files != NULL )
+		fclose(spill.files);
+	memset(&spill, 0, sizeof(spill));
+}
+
+/*
+ * FUNCTION
+ *	FILE *open_index(char index_file[], struct idx_header *hdr)
+ * DESCRIPTION
+ *	Opens a function index file and reads and validates its header: the
+ *	record sizes, counts and section offsets must be those of an index
+ *	written by this version.
+ * PARAMETERS
+ *	char index_file[] - name of the index file
+ *	struct idx_header *hdr - receives the index header
+ * RETURN VALUE
+ *	The open index file positioned at the first record, NULL on error.
+ */
+FILE *open_index(char index_file[], struct idx_header *hdr)
+{
+	FILE *ip;
+
+	ip = fopen(index_file, "rb");
+	if ( ip == NULL )
+	{
+		fprintf(stderr, "Cannot open %s\n", index_file);
+		return NULL;
+	}
+	if ( !read_idx_header(ip, hdr)
+	     || memcmp(hdr->magic, IDX_MAGIC, sizeof(hdr->magic)) != 0
+	     || hdr->rec_size != IDX_REC_SIZE
+	     || hdr->file_rec_size != IDX_FILE_SIZE
+	     || hdr->count < 0 || hdr->file_count < 0
+	     || hdr->loc_pos != IDX_HEADER_SIZE + (int64_t)hdr->count * IDX_REC_SIZE
+	     || hdr->file_pos != hdr->loc_pos + (int64_t)hdr->count * IDX_LOC_SIZE
+	     || hdr->str_pos != hdr->file_pos + (int64_t)hdr->file_count * IDX_FILE_SIZE
+	     || hdr->str_size < 1 )
+	{
+		fprintf(stderr, "%s is not a FnLoC index file\n", index_file);
+		fclose(ip);
+		return NULL;
+	}
+	return ip;
+}
+
+/*
+ * FUNCTION
+ *	int load_index(FILE *ip, struct idx_header *hdr, char index_file[])
+ * DESCRIPTION
+ *	Reads the functions and file totals of a function index and appends
+ *	them to the linked lists. The string table is read whole and every
+ *	offset checked against it before it is used.
+ * PARAMETERS
+ *	FILE *ip - the index, opened by open_index()
+ *	struct idx_header *hdr - its header
+ *	char index_file[] - name of the index file, for error messages
+ * RETURN VALUE
+ *	1 on success, 0 if the index is corrupt
+ */
+int load_index(FILE *ip, struct idx_header *hdr, char index_file[])
+{
+	struct idx_rec rec;
+	struct idx_file frec;
+	struct file_data *file;
+	struct fn_pos pos;
+	char *table;
+	char *name1, *name2, *name;
+	int ok;
+	int n;
+
+	table = malloc((size_t)hdr->str_size);
+	if ( table == NULL )
+	{
+		fprintf(stderr, "Out of space\n");
+		exit(1);
+	}
+	ok = fseek(ip, (long)hdr->str_pos, SEEK_SET) == 0
+	     && fread(table, 1, (size_t)hdr->str_size, ip) == (size_t)hdr->str_size
+	     && table[hdr->str_size - 1] == '\0'
+	     && fseek(ip, IDX_HEADER_SIZE, SEEK_SET) == 0;
+
+	for ( n = 0; ok && n < hdr->count; n++ )
+	{
+		ok = read_idx_rec(ip, &rec)
+		     && (name1 = idx_str(table, hdr, rec.name1)) != NULL
+		     && (name2 = idx_str(table, hdr, rec.name2)) != NULL
+		     && (name = idx_str(table, hdr, rec.file)) != NULL;
+		if ( !ok )
+			break;
+		pos.start_line = rec.start_line;
+		pos.end_line = rec.end_line;
+		pos.start_offset = rec.start_offset;
+		pos.end_offset = rec.end_offset;
+		insert_at_end(name1, name2, name, &pos, rec.loc);
+		last->metrics.branches = rec.branches;
+		last->metrics.depth = rec.depth;
+		last->metrics.returns = rec.returns;
+	}
+
+	ok = ok && fseek(ip, (long)hdr->file_pos, SEEK_SET) == 0;
+	for ( n = 0; ok && n < hdr->file_count; n++ )
+	{
+		ok = read_idx_file(ip, &frec)
+		     && (name = idx_str(table, hdr, frec.file)) != NULL;
+		if ( !ok )
+			break;
+		file = insert_file(name);
+		file->seq = frec.seq;
+		file->prg_loc = frec.prg_loc;
+		file->fn_count = frec.fn_count;
+		file->fn_loc = frec.fn_loc;
+		file->kind = frec.kind;
+		file->skipped = frec.skipped;
+		file->dead_loc = frec.dead_loc;
+	}
+
+	if ( !ok )
+		fprintf(stderr, "%s is corrupt\n", index_file);
+	free(table);
+	return ok;
+}
+
+/*
+ * FUNCTION
+ *	char *idx_str(char table[], struct idx_header *hdr, int64_t offset)
+ * DESCRIPTION
+ *	Finds a name in a string table read whole by load_index(). The table
+ *	has been checked to end with a NUL, so any offset inside it is the
+ *	start of a terminated string.
+ * PARAMETERS
+ *	char table[] - the string table
+ *	struct idx_header *hdr - header of the index
+ *	int64_t offset - offset of the name, from a record
+ * RETURN VALUE
+ *	The name, NULL if the offset is outside the table
+ */
+char *idx_str(char table[], struct idx_header *hdr, int64_t offset)
+{
+	if ( offset < 0 || offset >= hdr->str_size )
+		return NULL;
+	return table + offset;
+}
+
+/*
+ * FUNCTION
+ *	int read_idx_entry(FILE *ip, struct idx_header *hdr, int64_t n,
+ *			   struct idx_entry *entry)
+ * DESCRIPTION
+ *	Reads record n of an index, in key order, and its names.
+ * PARAMETERS
+ *	FILE *ip - the index, opened by open_index()
+ *	struct idx_header *hdr - its header
+ *	int64_t n - number of the record
+ *	struct idx_entry *entry - receives the record and its names
+ * RETURN VALUE
+ *	1 on success, 0 if the record or a name could not be read
+ */
+int read_idx_entry(FILE *ip, struct idx_header *hdr, int64_t n, struct idx_entry *entry)
+{
+	if ( n < 0 || n >= hdr->count
+	     || fseek(ip, (long)(IDX_HEADER_SIZE + n * IDX_REC_SIZE), SEEK_SET) != 0
+	     || !read_idx_rec(ip, &entry->rec) )
+		return 0;
+
+	return read_idx_field(ip, hdr, entry->rec.key, entry->key, BUF_LEN)
+	       && read_idx_field(ip, hdr, entry->rec.name1, entry->name1, BUF_LEN)
+	       && read_idx_field(ip, hdr, entry->rec.name2, entry->name2, BUF_LEN)
+	       && read_idx_field(ip, hdr, entry->rec.file, entry->file, PATH_LEN);
+}
+
+/*
+ * FUNCTION
+ *	int read_idx_field(FILE *ip, struct idx_header *hdr, int64_t offset,
+ *			   char str[], int size)
+ * DESCRIPTION
+ *	Reads one name from the string table of an index. The name must lie
+ *	inside the table and end with a NUL within size bytes.
+ * PARAMETERS
+ *	FILE *ip - the index
+ *	struct idx_header *hdr - its header
+ *	int64_t offset - offset of the name in the string table
+ *	char str[] - receives the name
+ *	int size - size of str
+ * RETURN VALUE
+ *	1 on success, 0 if the name is out of bounds or too long
+ */
+int read_idx_field(FILE *ip, struct idx_header *hdr, int64_t offset, char str[], int size)
+{
+	size_t len;
+
+	if ( offset < 0 || offset >= hdr->str_size )
+		return 0;
+	len = hdr->str_size - offset < size ? (size_t)(hdr->str_size - offset) : (size_t)size;
+	if ( fseek(ip, (long)(hdr->str_pos + offset), SEEK_SET) != 0
+	     || fread(str, 1, len, ip) != len )
+		return 0;
+
+	return memchr(str, '\0', len) != NULL;
+}
+
+/*
+ * FUNCTION
+ *	int find_in_index(char index_file[], char name[])
+ * DESCRIPTION
+ *	Binary searches the index file for functions named name and displays
+ *	every match. Only the records probed by the search are read.
+ * PARAMETERS
+ *	char index_file[] - name of the index file
+ *	char name[] - function name to look up
+ * RETURN VALUE
+ *	Number of matching functions, 0 if none or on error
+ */
+int find_in_index(char index_file[], char name[])
+{
+	struct idx_header hdr;
+	struct idx_entry entry;
+	FILE *ip;
+	int32_t low, high, mid;
+	int found = 0;
+	int ok = 1;
+
+	ip = open_index(index_file, &hdr);
+	if ( ip == NULL )
+		return 0;
+
+	/* find the first record with key >= name */
+	low = 0;
+	high = hdr.count;
+	while ( ok && low < high )
+	{
+		mid = low + (high - low) / 2;
+		ok = read_idx_entry(ip, &hdr, mid, &entry);
+		if ( ok && strcmp(entry.key, name) < 0 )
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	for ( ; ok && low < hdr.count; low++ )
+	{
+		ok = read_idx_entry(ip, &hdr, low, &entry);
+		if ( !ok || strcmp(entry.key, name) != 0 )
+			break;
+		print_idx_rec(&entry);
+		found++;
+	}
+
+	if ( !ok )
+		fprintf(stderr, "%s is corrupt\n", index_file);
+	else if ( found == 0 )
+		fprintf(stderr, "%s not found in %s\n", name, index_file);
+	fclose(ip);
+	return found;
+}
+
+/*
+ * FUNCTION
+ *	int list_index_over(char index_file[], int min_loc)
+ * DESCRIPTION
+ *	Displays every function in the index with more than min_loc lines
+ *	of code, largest first. The end of those functions in the LOC
+ *	section is found with a binary search, so only the functions shown
+ *	are read.
+ * PARAMETERS
+ *	char index_file[] - name of the index file
+ *	int min_loc - LOC threshold
+ * RETURN VALUE
+ *	1 if the index could be read, 0 on error
+ */
+int list_index_over(char index_file[], int min_loc)
+{
+	struct idx_header hdr;
+	struct idx_entry entry;
+	struct idx_loc loc;
+	FILE *ip;
+	int32_t low, high, mid, n;
+	int ok = 1;
+
+	ip = open_index(index_file, &hdr);
+	if ( ip == NULL )
+		return 0;
+
+	/* find the first function with min_loc or fewer LOC */
+	low = 0;
+	high = hdr.count;
+	while ( ok && low < high )
+	{
+		mid = low + (high - low) / 2;
+		ok = fseek(ip, (long)(hdr.loc_pos + (int64_t)mid * IDX_LOC_SIZE), SEEK_SET) == 0
+		     && read_idx_loc(ip, &loc);
+		if ( ok && loc.loc > min_loc )
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	for ( n = 0; ok && n < low; n++ )
+	{
+		ok = fseek(ip, (long)(hdr.loc_pos + (int64_t)n * IDX_LOC_SIZE), SEEK_SET) == 0
+		     && read_idx_loc(ip, &loc)
+		     && read_idx_entry(ip, &hdr, loc.rec, &entry);
+		if ( ok )
+			print_idx_rec(&entry);
+	}
+
+	if ( !ok )
+		fprintf(stderr, "%s is corrupt\n", index_file);
+	fclose(ip);
+	return ok;
+}
+
+/*
+ * FUNCTION
+ *	void print_idx_rec(struct idx_entry *entry)
+ * DESCRIPTION
+ *	Displays one function index record as file:start-end, the byte
+ *	offsets, LOC and header.
+ * PARAMETERS
+ *	struct idx_entry *entry - the record to display, with its names
+ * RETURN VALUE
+ *	None
+ */
+void print_idx_rec(struct idx_entry *entry)
+{
+	printf("%s:%d-%d\t@%ld-%ld\tLOC: %4d\t%s", entry->file,
+	       entry->rec.start_line, entry->rec.end_line,
+	       (long)entry->rec.start_offset, (long)entry->rec.end_offset, entry->rec.loc,
+	       entry->name1);
+	if ( strcmp(entry->name2, "") != 0 )
+		printf("\t\t\t%s", entry->name2);
+}
+
+/*
+ * FUNCTION
+ *	void map_char(char ch, STATETYPE st)
+ * DESCRIPTION
+ *	Records what kind of character was just scanned for the line map.
+ * PARAMETERS
+ *	char ch - the character scanned
+ *	STATETYPE st - the line state after scanning ch
+ * RETURN VALUE
+ *	None, updates lmap.flags
+ */
+void map_char(char ch, STATETYPE st)
+{
+	if ( isspace((unsigned char)ch) )
+		return;
+
+	if ( !(lmap.flags & LM_TEXT) && st == CompDir )
+		lmap.flags |= LM_DIRECTIVE;
+	lmap.flags |= LM_TEXT;
+
+	switch (st)
+	{
+		case CompDir:
+		case LineOfCode:
+		case OpenBracket:
+		case CloseBracket1:
+		case CloseBracket2:
+		case PosEOL:
+			lmap.flags |= LM_CODE;
+			break;
+		default:
+			break;
+	}
+
+	if ( ch != '{' && ch != '}' && ch != ';' )
+		lmap.flags |= LM_NONBRACE;
+}
+
+/*
+ * FUNCTION
+ *	void map_line(long line_offset)
+ * DESCRIPTION
+ *	Classifies the physical line just scanned from the flags gathered by
+ *	map_char() and appends it to the line map.
+ * PARAMETERS
+ *	long line_offset - byte offset of the start of the line
+ * RETURN VALUE
+ *	None, exits if out of memory
+ */
+void map_line(long line_offset)
+{
+	LINECLASS lc;
+
+	if ( lmap.lines == lmap.size )
+	{
+		lmap.size = lmap.size ? lmap.size * 2 : 1024;
+		lmap.classes = realloc(lmap.classes, lmap.size);
+		lmap.offsets = realloc(lmap.offsets, lmap.size * sizeof(int));
+		if ( lmap.classes == NULL || lmap.offsets == NULL )
+		{
+			fprintf(stderr, "Out of space\n");
+			exit(1);
+		}
+	}
+
+	if ( lmap.flags & LM_DEAD )
+		lc = LineDead;
+	else if ( !(lmap.flags & LM_TEXT) )
+		lc = LineBlank;
+	else if ( lmap.flags & LM_DIRECTIVE )
+		lc = LineDirective;
+	else if ( !(lmap.flags & LM_CODE) )
+		lc = LineComment;
+	else if ( !(lmap.flags & LM_NONBRACE) )
+		lc = LineBrace;
+	else if ( lmap.flags & LM_COUNTED )
+		lc = LineCode;
+	else
+		lc = LineContinued;
+
+	lmap.classes[lmap.lines] = lc | ((lmap.flags & LM_COUNTED) ? LM_LOC : 0);
+	lmap.offsets[lmap.lines] = line_offset;
+	lmap.lines++;
+	lmap.flags = 0;
+}
+
+/*
+ * FUNCTION
+ *	void write_line_map(char map_file[], long file_size)
+ * DESCRIPTION
+ *	Writes the line map with its classes packed two lines per byte,
+ *	followed by the line offset index, then frees the map.
+ * PARAMETERS
+ *	char map_file[] - name of the line map file to create
+ *	long file_size - size of the source file, stored as the final offset
+ * RETURN VALUE
+ *	None, exits on error
+ */
+void write_line_map(char map_file[], long file_size)
+{
+	struct lm_header hdr;
+	unsigned char packed;
+	int end = file_size;
+	FILE *mp;
+	int n;
+
+	mp = fopen(map_file, "wb");
+	if ( mp == NULL )
+	{
+		fprintf(stderr, "Cannot create %s\n", map_file);
+		exit(1);
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, LMAP_MAGIC, sizeof(hdr.magic));
+	hdr.lines = lmap.lines;
+	hdr.bits = 4;
+	fwrite(&hdr, sizeof(hdr), 1, mp);
+
+	for ( n = 0; n < lmap.lines; n += 2 )
+	{
+		packed = lmap.classes[n];
+		if ( n + 1 < lmap.lines )
+			packed |= lmap.classes[n + 1] << 4;
+		fputc(packed, mp);
+	}
+
+	fwrite(lmap.offsets, sizeof(int), lmap.lines, mp);
+	fwrite(&end, sizeof(int), 1, mp);
+
+	if ( ferror(mp) )
+	{
+		fprintf(stderr, "Cannot write %s\n", map_file);
+		exit(1);
+	}
+	fclose(mp);
+
+	free(lmap.classes);
+	free(lmap.offsets);
+	memset(&lmap, 0, sizeof(lmap));
+}
+
+/*
+ * FUNCTION
+ *	int count_history(char stream[])
+ * DESCRIPTION
+ *	Counts the lines of code of every commit in a history stream, counting
+ *	each distinct blob only once. The stream holds one record per file of
+ *	each commit, a header line
+ *		<blob-id> <size> <commit> <path>
+ *	followed by size bytes of content and a newline, which is the output
+ *	of git cat-file --batch='%(objectname) %(objectsize) %(rest)' given
+ *	lines of "<blob-id> <commit> <path>". Records for a commit must be
+ *	together. The totals of each blob are kept in a hash table and reused
+ *	when the blob is seen again, so unchanged files are not recounted.
+ * PARAMETERS
+ *	char stream[] - name of the history stream, "-" for standard input
+ * RETURN VALUE
+ *	0 on success, exits on error
+ */
+int count_history(char stream[])
+{
+	char header[ID_LEN * 2 + PATH_LEN + 32];
+	char blob[ID_LEN], commit[ID_LEN], path[PATH_LEN];
+	char current[ID_LEN] = "";
+	struct blob_memo *memo, *found, *grown;
+	struct file_data *rec;
+	struct input in;
+	FILE *hp;
+	char *data = NULL;
+	long data_size = 0;
+	long size;
+	int memo_size = 1024;
+	int memo_count = 0;
+	int blobs = 0;
+	int file_count = 0, prg_loc = 0, fn_count = 0, fn_loc = 0;
+	double start;		/* wall clock time at the start of a stage */
+	int n;
+
+	if ( strcmp(stream, "-") == 0 )
+		hp = binary_stdin();
+	else
+		hp = fopen(stream, "rb");
+	if ( hp == NULL )
+	{
+		fprintf(stderr, "Cannot open %s\n", stream);
+		exit(1);
+	}
+
+	memo = calloc(memo_size, sizeof(struct blob_memo));
+	if ( memo == NULL )
+	{
+		fprintf(stderr, "Out of space\n");
+		exit(1);
+	}
+
+	print_banner();
+	printf("Lines of code history for %s\n\n", stream);
+
+	while ( fgets(header, sizeof(header), hp) )
+	{
+		strcpy(path, "");
+		if ( sscanf(header, "%71s %ld %71s %259[^\n]", blob, &size, commit, path) < 3 )
+			continue;	/* "<blob-id> missing" or a blank line */
+
+		if ( strcmp(commit, current) != 0 )
+		{
+			if ( strcmp(current, "") != 0 )
+				print_commit(current, file_count, prg_loc, fn_count, fn_loc);
+			strcpy(current, commit);
+			file_count = prg_loc = fn_count = fn_loc = 0;
+		}
+
+		found = find_blob(memo, memo_size, blob);
+		if ( strcmp(found->id, "") != 0 )
+		{
+			/* seen before, skip the content */
+			for ( ; size > 0; size-- )
+				getc(hp);
+			prom.cache_hits++;
+		}
+		else
+		{
+			prom.cache_misses++;
+			start = wall_clock();
+			if ( size + 1 > data_size )
+			{
+				data_size = size + 1;
+				data = realloc(data, data_size);
+				if ( data == NULL )
+				{
+					fprintf(stderr, "Out of space\n");
+					exit(1);
+				}
+			}
+			if ( (long)fread(data, 1, size, hp) != size )
+			{
+				fprintf(stderr, "%s: content of %s is cut short\n", stream, blob);
+				exit(1);
+			}
+			observe_stage(StageRead, wall_clock() - start);
+
+			memset(&in, 0, sizeof(in));
+			in.fd = -1;
+			in.data = data;
+			in.size = size;
+			start = wall_clock();
+			rec = count_file(&in, path);
+			observe_stage(StageScan, wall_clock() - start);
+			count_metrics(rec);
+
+			strcpy(found->id, blob);
+			found->prg_loc = rec->prg_loc;
+			found->fn_count = rec->fn_count;
+			found->fn_loc = rec->fn_loc;
+			head = free_list(head);
+			files = free_files(files);
+			blobs++;
+
+			/* keep the table no more than half full */
+			if ( ++memo_count * 2 > memo_size )
+			{
+				grown = calloc(memo_size * 2, sizeof(struct blob_memo));
+				if ( grown == NULL )
+				{
+					fprintf(stderr, "Out of space\n");
+					exit(1);
+				}
+				for ( n = 0; n < memo_size; n++ )
+					if ( strcmp(memo[n].id, "") != 0 )
+						*find_blob(grown, memo_size * 2, memo[n].id) = memo[n];
+				free(memo);
+				memo = grown;
+				memo_size *= 2;
+				found = find_blob(memo, memo_size, blob);
+			}
+		}
+		getc(hp);	/* newline after the content */
+
+		file_count++;
+		prg_loc += found->prg_loc;
+		fn_count += found->fn_count;
+		fn_loc += found->fn_loc;
+		update_metrics(0);
+	}
+
+	if ( strcmp(current, "") != 0 )
+		print_commit(current, file_count, prg_loc, fn_count, fn_loc);
+	printf("\nBlobs counted: %d\n\n", blobs);
+	update_metrics(1);
+
+	if ( hp != stdin )
+		fclose(hp);
+	free(memo);
+	free(data);
+
+	return 0;
+}
+
+/*
+ * FUNCTION
+ *	FILE *binary_stdin(void)
+ * DESCRIPTION
+ *	Switches standard input to binary mode so that byte counts read from
+ *	it are not changed by newline translation on Windows.
+ * PARAMETERS
+ *	None
+ * RETURN VALUE
+ *	stdin
+ */
+FILE *binary_stdin(void)
+{
+#ifdef _WIN32
+	_setmode(_fileno(stdin), _O_BINARY);
+#endif
+	return stdin;
+}
+
+/*
+ * FUNCTION
+ *	struct blob_memo *find_blob(struct blob_memo *memo, int size, char id[])
+ * DESCRIPTION
+ *	Looks up a blob id in an open addressing hash table of blob totals.
+ * PARAMETERS
+ *	struct blob_memo *memo - the hash table
+ *	int size - number of entries in the table, a power of 2
+ *	char id[] - the blob id
+ * RETURN VALUE
+ *	The entry for id, or the empty entry where id belongs
+ */
+struct blob_memo *find_blob(struct blob_memo *memo, int size, char id[])
+{
+	unsigned long h = 2166136261UL;
+	char *p;
+
+	for ( p = id; *p; p++ )
+		h = (h ^ (unsigned char)*p) * 16777619UL;
+
+	for ( h &= size - 1; strcmp(memo[h].id, "") != 0; h = (h + 1) & (size - 1) )
+		if ( strcmp(memo[h].id, id) == 0 )
+			break;
+
+	return &memo[h];
+}
+
+/*
+ * FUNCTION
+ *	void print_commit(char commit[], int file_count, int prg_loc,
+ *			  int fn_count, int fn_loc)
+ * DESCRIPTION
+ *	Displays the totals for one commit of a history stream.
+ * PARAMETERS
+ *	char commit[] - the commit id
+ *	int file_count - number of files in the commit
+ *	int prg_loc - total lines of code
+ *	int fn_count - number of functions
+ *	int fn_loc - lines of code in functions
+ * RETURN VALUE
+ *	None
+ */
+void print_commit(char commit[], int file_count, int prg_loc, int fn_count,
+		  int fn_loc)
+{
+	printf("%s\tFiles: %4d\tLOC: %6d\tFunctions: %5d\tFunction LOC: %6d\n",
+	       commit, file_count, prg_loc, fn_count, fn_loc);
+}
+
+/*
+ * FUNCTION
+ *	int count_stream(void)
+ * DESCRIPTION
+ *	Counts source code files sent in framed records on standard input and
+ *	writes one framed result per record to standard output. Nothing is
+ *	read from or written to the file system. A record is a header line
+ *		<path-length> <content-length>
+ *	followed by the path and the content, each exactly that many bytes.
+ *	A result is framed the same way, a header line
+ *		<path-length> <result-length>
+ *	followed by the path and the result text, which is one line
+ *		file<TAB>prg_loc<TAB>fn_count<TAB>fn_loc
+ *	and one line per function
+ *		fn<TAB>start_line<TAB>end_line<TAB>loc<TAB>header
+ *	Output is flushed after every result.
+ * PARAMETERS
+ *	None
+ * RETURN VALUE
+ *	0 at the end of the stream, exits on a malformed record
+ */
+int count_stream(void)
+{
+	char header[64];
+	char path[PATH_LEN];
+	struct file_data *rec;
+	struct text result;
+	struct input in;
+	FILE *sp;
+	char *data = NULL;
+	long data_size = 0;
+	long path_len, size;
+	double start;		/* wall clock time at the start of a stage */
+
+	sp = binary_stdin();
+#ifdef _WIN32
+	_setmode(_fileno(stdout), _O_BINARY);
+#endif
+	memset(&result, 0, sizeof(result));
+
+	while ( fgets(header, sizeof(header), sp) )
+	{
+		if ( sscanf(header, "%ld %ld", &path_len, &size) != 2
+		     || path_len < 0 || path_len >= PATH_LEN || size < 0 )
+		{
+			fprintf(stderr, "Invalid stream record header: %s", header);
+			exit(1);
+		}
+		start = wall_clock();
+
+		if ( size + 1 > data_size )
+		{
+			data_size = size + 1;
+			data = realloc(data, data_size);
+			if ( data == NULL )
+			{
+				fprintf(stderr, "Out of space\n");
+				exit(1);
+			}
+		}
+		if ( (long)fread(path, 1, path_len, sp) != path_len
+		     || (long)fread(data, 1, size, sp) != size )
+		{
+			fprintf(stderr, "Stream record is cut short\n");
+			exit(1);
+		}
+		path[path_len] = '\0';
+		observe_stage(StageRead, wall_clock() - start);
+
+		memset(&in, 0, sizeof(in));
+		in.fd = -1;
+		in.data = data;
+		in.size = size;
+		start = wall_clock();
+		rec = count_file(&in, path);
+		observe_stage(StageScan, wall_clock() - start);
+
+		start = wall_clock();
+		result.len = 0;
+		format_result(rec, &result);
+		printf("%ld %ld\n%s", path_len, result.len, path);
+		fwrite(result.data, 1, result.len, stdout);
+		fflush(stdout);
+		observe_stage(StageFormat, wall_clock() - start);
+		count_metrics(rec);
+		update_metrics(0);
+
+		head = free_list(head);
+		last = NULL;
+		files = free_files(files);
+	}
+
+	update_metrics(1);
+	free(data);
+	free(result.data);
+
+	return 0;
+}
+
+/*
+ * FUNCTION
+ *	void format_result(struct file_data *rec, struct text *out)
+ * DESCRIPTION
+ *	Appends the totals and functions of a file to a text buffer as tab
+ *	separated lines. Function headers split over two lines are joined.
+ * PARAMETERS
+ *	struct file_data *rec - the file to format
+ *	struct text *out - the text buffer
+ * RETURN VALUE
+ *	None
+ */
+void format_result(struct file_data *rec, struct text *out)
+{
+	node *current;
+	char *name2;		/* second header line without its indent */
+	int n;
+
+	text_printf(out, "file\t%d\t%d\t%d\n", rec->prg_loc, rec->fn_count,
+		    rec->fn_loc);
+
+	for ( n = 0, current = rec->first_fn; n < rec->fn_count && current != NULL;
+	      n++, current = current->next )
+	{
+		text_printf(out, "fn\t%d\t%d\t%d\t%.*s", current->pos.start_line,
+			    current->pos.end_line, current->loc,
+			    (int)strcspn(current->name1, "\r\n"), current->name1);
+		if ( strcmp(current->name2, "") != 0 )
+		{
+			name2 = current->name2 + strspn(current->name2, " \t");
+			text_printf(out, " %.*s", (int)strcspn(name2, "\r\n"), name2);
+		}
+		text_printf(out, "\n");
+	}
+}
+
+/*
+ * FUNCTION
+ *	void text_printf(struct text *out, const char *format, ...)
+ * DESCRIPTION
+ *	Appends formatted text to a text buffer, growing it as needed.
+ * PARAMETERS
+ *	struct text *out - the text buffer
+ *	const char *format - printf() format and its arguments
+ * RETURN VALUE
+ *	None, exits if out of memory
+ */
+void text_printf(struct text *out, const char *format, ...)
+{
+	va_list args;
+	int n;
+
+	for ( ;; )
+	{
+		va_start(args, format);
+		n = vsnprintf(out->data + out->len, out->size - out->len, format, args);
+		va_end(args);
+
+		if ( n >= 0 && out->len + n < out->size )
+			break;
+
+		out->size = out->size ? out->size * 2 : 1024;
+		if ( n >= 0 && out->size < out->len + n + 1 )
+			out->size = out->len + n + 1;
+		out->data = realloc(out->data, out->size);
+		if ( out->data == NULL )
+		{
+			fprintf(stderr, "Out of space\n");
+			exit(1);
+		}
+	}
+	out->len += n;
+}
+
+/*
+ * FUNCTION
+ *	void load_results(char arg[], struct result_set *set)
+ * DESCRIPTION
+ *	Loads the functions and file totals for one side of a comparison.
+ *	arg is either a function index written by --index, or source code
+ *	files named as they are for a count: a file, a directory tree, an
+ *	@file response file or -0 for names on standard input. The files are
+ *	recorded under their names less the directory they all share, so the
+ *	same files of two trees, or of a tree and an index, have the same
+ *	names.
+ * PARAMETERS
+ *	char arg[] - name of an index file, or the source code files
+ *	struct result_set *set - receives the functions and files
+ * RETURN VALUE
+ *	None, exits if arg cannot be read
+ */
+void load_results(char arg[], struct result_set *set)
+{
+	struct idx_header hdr;
+	struct name_list names;
+	struct file_data *file;
+	struct input in;
+	size_t common;		/* length of the directory shared by the names */
+	size_t len;
+	node *fn;
+	FILE *ip;
+	int n;
+
+	head = last = NULL;
+	files = last_file = NULL;
+
+	memset(&names, 0, sizeof(names));
+	collect_names(&names, arg);
+	if ( names.count == 0 )
+	{
+		fprintf(stderr, "No source code files in %s\n", arg);
+		exit(1);
+	}
+
+	ip = names.count == 1 ? fopen(names.names[0], "rb") : NULL;
+	if ( names.count == 1 && ip == NULL )
+	{
+		fprintf(stderr, "Cannot open %s\n", names.names[0]);
+		exit(1);
+	}
+
+	if ( ip != NULL && read_idx_header(ip, &hdr)
+	     && memcmp(hdr.magic, IDX_MAGIC, sizeof(hdr.magic)) == 0 )
+	{
+		fclose(ip);
+		ip = open_index(names.names[0], &hdr);
+		if ( ip == NULL )
+			exit(1);
+		if ( !load_index(ip, &hdr, names.names[0]) )
+			exit(1);
+		fclose(ip);
+	}
+	else
+	{
+		if ( ip != NULL )
+			fclose(ip);
+		for ( n = 0; n < names.count; n++ )
+		{
+			if ( !open_source(&in, names.names[n]) )
+				exit(1);
+			count_file(&in, names.names[n]);
+			close_source(&in);
+		}
+	}
+	free_names(&names);
+
+	/* the directory part of the first name, cut to what all share */
+	if ( files != NULL )
+	{
+		common = strlen(files->file);
+		for ( file = files->next; file != NULL; file = file->next )
+			for ( len = 0; len < common; len++ )
+				if ( file->file[len] != files->file[len] )
+				{
+					common = len;
+					break;
+				}
+		while ( common > 0 && files->file[common - 1] != '/'
+			&& files->file[common - 1] != '\\' )
+			common--;
+		for ( fn = head; fn != NULL; fn = fn->next )
+			if ( strncmp(fn->file, files->file, common) == 0 )
+				fn->file += common;
+		for ( file = files->next; file != NULL; file = file->next )
+			file->file += common;
+		files->file += common;
+	}
+
+	set->fns = head;
+	set->files = files;
+	set->fn_count = 0;
+	set->file_count = 0;
+	for ( ; head != NULL; head = head->next )
+		set->fn_count++;
+	for ( ; files != NULL; files = files->next )
+		set->file_count++;
+	last = NULL;
+	last_file = NULL;
+}
+
+/*
+ * FUNCTION
+ *	unsigned long hash_fn(node *fn, int use_file)
+ * DESCRIPTION
+ *	FNV-1a hash of a function's header text, and optionally its file name,
+ *	used to join the functions of two result sets.
+ * PARAMETERS
+ *	node *fn - the function to hash
+ *	int use_file - include the file name in the hash
+ * RETURN VALUE
+ *	The hash value
+ */
+unsigned long hash_fn(node *fn, int use_file)
+{
+	unsigned long h = 2166136261UL;
+	char *p;
+
+	if ( use_file )
+		for ( p = fn->file; *p; p++ )
+			h = (h ^ (unsigned char)*p) * 16777619UL;
+	for ( p = fn->name1; *p; p++ )
+		h = (h ^ (unsigned char)*p) * 16777619UL;
+	for ( p = fn->name2; *p; p++ )
+		h = (h ^ (unsigned char)*p) * 16777619UL;
+
+	return h & 0xffffffffUL;
+}
+
+/*
+ * FUNCTION
+ *	int compare_results(char old_arg[], char new_arg[])
+ * DESCRIPTION
+ *	Displays the LOC changes between two result sets. The old functions
+ *	are loaded into a hash table keyed by file and header text and the new
+ *	functions are looked up in it, so matching is linear in the number of
+ *	functions. If each side holds a single file the file names are not
+ *	compared. Changed, added and removed functions are listed, followed
+ *	by the per file and total changes. The files of both sides are
+ *	sorted by name and merged.
+ * PARAMETERS
+ *	char old_arg[] - index or source code files for the old version
+ *	char new_arg[] - index or source code files for the new version
+ * RETURN VALUE
+ *	0 on success, exits on error
+ */
+int compare_results(char old_arg[], char new_arg[])
+{
+	struct result_set old_set, new_set;
+	struct file_data **old_files, **new_files;
+	struct file_data *file;
+	node **table;		/* old functions, by bucket */
+	int *chain;		/* next old function in the same bucket */
+	int *bucket;		/* first old function in each bucket */
+	char *matched;		/* old function was found in the new set */
+	char *added;		/* new function was not found in the old set */
+	node *fn;
+	int use_file;
+	int size;
+	int n, k;
+	int cmp;
+	unsigned long h;
+	int old_total = 0, new_total = 0;
+
+	load_results(old_arg, &old_set);
+	load_results(new_arg, &new_set);
+	use_file = !(old_set.file_count == 1 && new_set.file_count == 1);
+
+	for ( size = 16; size < 2 * old_set.fn_count; size *= 2 )
+		;
+	table = malloc((old_set.fn_count + 1) * sizeof(node *));
+	chain = malloc((old_set.fn_count + 1) * sizeof(int));
+	matched = calloc(old_set.fn_count + 1, 1);
+	added = calloc(new_set.fn_count + 1, 1);
+	bucket = malloc(size * sizeof(int));
+	old_files = malloc((old_set.file_count + 1) * sizeof(struct file_data *));
+	new_files = malloc((new_set.file_count + 1) * sizeof(struct file_data *));
+	if ( table == NULL || chain == NULL || matched == NULL || added == NULL
+	     || bucket == NULL || old_files == NULL || new_files == NULL )
+	{
+		fprintf(stderr, "Out of space\n");
+		exit(1);
+	}
+
+	/* build */
+	for ( k = 0; k < size; k++ )
+		bucket[k] = -1;
+	for ( n = 0, fn = old_set.fns; fn != NULL; fn = fn->next, n++ )
+	{
+		h = hash_fn(fn, use_file) & (size - 1);
+		table[n] = fn;
+		chain[n] = bucket[h];
+		bucket[h] = n;
+	}
+
+	print_banner();
+	printf("Lines of code changes from %s to %s\n\n", old_arg, new_arg);
+
+	/* probe */
+	printf("Changed functions:\n");
+	for ( n = 0, fn = new_set.fns; fn != NULL; fn = fn->next, n++ )
+	{
+		h = hash_fn(fn, use_file) & (size - 1);
+		for ( k = bucket[h]; k != -1; k = chain[k] )
+			if ( !matched[k] && table[k]->header == fn->header
+			     && (!use_file || strcmp(table[k]->file, fn->file) == 0) )
+				break;
+
+		if ( k == -1 )
+		{
+			added[n] = 1;
+			continue;
+		}
+		matched[k] = 1;
+		if ( table[k]->loc != fn->loc )
+		{
+			printf("%s", fn->name1);
+			if ( strcmp(fn->name2, "") != 0 )
+				printf("%s", fn->name2);
+			print_delta("LOC:\t", table[k]->loc, fn->loc);
+		}
+	}
+
+	printf("\nAdded functions:\n");
+	for ( n = 0, fn = new_set.fns; fn != NULL; fn = fn->next, n++ )
+	{
+		if ( !added[n] )
+			continue;
+		printf("%s", fn->name1);
+		if ( strcmp(fn->name2, "") != 0 )
+			printf("%s", fn->name2);
+		printf("LOC:\t%4d\n", fn->loc);
+	}
+
+	printf("\nRemoved functions:\n");
+	for ( n = 0; n < old_set.fn_count; n++ )
+	{
+		if ( matched[n] )
+			continue;
+		printf("%s", table[n]->name1);
+		if ( strcmp(table[n]->name2, "") != 0 )
+			printf("%s", table[n]->name2);
+		printf("LOC:\t%4d\n", table[n]->loc);
+	}
+
+	/* match the files by name, merging the two sorted sets */
+	for ( n = 0, file = old_set.files; file != NULL; file = file->next )
+	{
+		old_files[n++] = file;
+		old_total += file->prg_loc;
+	}
+	for ( n = 0, file = new_set.files; file != NULL; file = file->next )
+	{
+		new_files[n++] = file;
+		new_total += file->prg_loc;
+	}
+	if ( use_file )
+	{
+		qsort(old_files, old_set.file_count, sizeof(struct file_data *), compare_file_name);
+		qsort(new_files, new_set.file_count, sizeof(struct file_data *), compare_file_name);
+	}
+
+	printf("\nFiles:\n");
+	for ( n = k = 0; n < old_set.file_count || k < new_set.file_count; )
+	{
+		if ( n == old_set.file_count )
+			cmp = 1;
+		else if ( k == new_set.file_count )
+			cmp = -1;
+		else
+			cmp = use_file ? strcmp(old_files[n]->file, new_files[k]->file) : 0;
+
+		if ( cmp < 0 )
+		{
+			printf("%s\n", old_files[n]->file);
+			print_delta("LOC:\t", old_files[n++]->prg_loc, 0);
+		}
+		else if ( cmp > 0 )
+		{
+			printf("%s\n", new_files[k]->file);
+			print_delta("LOC:\t", 0, new_files[k++]->prg_loc);
+		}
+		else
+		{
+			printf("%s\n", new_files[k]->file);
+			print_delta("LOC:\t", old_files[n++]->prg_loc, new_files[k++]->prg_loc);
+		}
+	}
+
+	printf("\nSummary:\n");
+	print_delta("Number of functions: ", old_set.fn_count, new_set.fn_count);
+	print_delta("Total Program LOC:   ", old_total, new_total);
+	printf("\n");
+
+	free(table);
+	free(chain);
+	free(matched);
+	free(added);
+	free(bucket);
+	free(old_files);
+	free(new_files);
+	free_list(old_set.fns);
+	free_list(new_set.fns);
+	free_files(old_set.files);
+	free_files(new_set.files);
+
+	return 0;
+}
+
+/*
+ * FUNCTION
+ *	void print_delta(char label[], int old_val, int new_val)
+ * DESCRIPTION
+ *	Displays an old and new value and the change between them.
+ * PARAMETERS
+ *	char label[] - text displayed before the values
+ *	int old_val - the old value
+ *	int new_val - the new value
+ * RETURN VALUE
+ *	None
+ */
+void print_delta(char label[], int old_val, int new_val)
+{
+	printf("%s%4d -> %4d  (%+d)\n", label, old_val, new_val, new_val - old_val);
+}
+
+/*
+ * FUNCTION
+ *	void start_progress(struct name_list *names)
+ * DESCRIPTION
+ *	Starts the progress report of a run over the files in names, if
+ *	--progress or --progress-fd was given.
+ * PARAMETERS
+ *	struct name_list *names - the source code files to count
+ * RETURN VALUE
+ *	None
+ */
+void start_progress(struct name_list *names)
+{
+	int n;
+
+	memset(&progress, 0, sizeof(progress));
+	if ( !opts.progress && opts.progress_fd == 0 && opts.prom_file == NULL )
+		return;
+	for ( n = 0; n < names->count; n++ )
+		progress.found += in_shard(names->names[n]);
+	progress.start = progress.shown = time(NULL);
+}
+
+/*
+ * FUNCTION
+ *	void file_progress(char source[], struct file_data *rec, double seconds)
+ * DESCRIPTION
+ *	Adds a file to the progress of the run and reports it if a second has
+ *	passed since the last report. Only time() is read for each file, so
+ *	the report costs nothing in the counting loop.
+ * PARAMETERS
+ *	char source[] - name of the source code file
+ *	struct file_data *rec - its totals, NULL if it could not be opened
+ *	double seconds - time taken to count it
+ * RETURN VALUE
+ *	None
+ */
+void file_progress(char source[], struct file_data *rec, double seconds)
+{
+	if ( progress.start == 0 )
+		return;
+	progress.done++;
+	if ( rec != NULL )
+	{
+		progress.bytes += rec->bytes;
+		progress.lines += rec->lines;
+	}
+	if ( progress.slowest[0] == '\0' || seconds > progress.slowest_time )
+	{
+		strncpy(progress.slowest, source, PATH_LEN - 1);
+		progress.slowest_time = seconds;
+	}
+	if ( time(NULL) != progress.shown )
+		show_progress(0);
 }
 
 /*
  * FUNCTION
- *	STATETYPE next_pos_comment(char ch)
+ *	void show_progress(int final)
  * DESCRIPTION
- *	Determines the next state if in PosComment state.
+ *	Reports the progress of the run: overwrites the progress line on
+ *	stderr for --progress and writes a line of name=value pairs to the
+ *	--progress-fd file descriptor.
  * PARAMETERS
- *	char ch - a character from the buffer containing the line of
- * 		  code being examined.
+ *	int final - non-zero for the last report, which ends the stderr line
  * RETURN VALUE
- *	Returns the new state.
- * SIDE EFFECTS
- *	None known
- * LIMITATIONS
- *	None known
+ *	None
  */
-STATETYPE next_pos_comment(char ch)
+void show_progress(int final)
 {
-	STATETYPE st;
+	char line[PATH_LEN + 256];
+	double elapsed, eta;
+	int len;
 
-	switch (ch)
+	if ( progress.start == 0 )
+		return;
+	progress.shown = time(NULL);
+	elapsed = difftime(progress.shown, progress.start);
+	if ( elapsed < 1.0 )
+		elapsed = 1.0;
+	eta = progress.done ? elapsed * (progress.found - progress.done) / progress.done : 0.0;
+
+	if ( opts.progress )
 	{
-		case '/':
-			st = CppComment;
-			break;
-		case '*':
-			st = Comment;
-			break;
-		default:
-			st = NewLineNC;
-			break;
+		len = sprintf(line, "%d/%d files, %.1f MB/s, %.0f lines/s, ETA %d:%02d, slowest %.*s",
+			      progress.done, progress.found,
+			      progress.bytes / elapsed / 1048576.0, progress.lines / elapsed,
+			      (int)eta / 60, (int)eta % 60, PATH_LEN - 1, progress.slowest);
+		fprintf(stderr, "\r%s%*s%s", line, progress.width > len ? progress.width - len : 0,
+			"", final ? "\n" : "");
+		progress.width = len;
+	}
+	if ( opts.progress_fd != 0 )
+	{
+		len = sprintf(line, "done=%d found=%d bytes=%.0f lines=%.0f elapsed=%.0f "
+			      "eta=%.0f slowest_seconds=%.3f slowest=%.*s\n",
+			      progress.done, progress.found, progress.bytes, progress.lines,
+			      difftime(progress.shown, progress.start), eta,
+			      progress.slowest_time, PATH_LEN - 1, progress.slowest);
+		if ( write(opts.progress_fd, line, len) != len )
+			opts.progress_fd = 0;
 	}
-
-	return st;
 }
 
 /*
  * FUNCTION
- *	STATETYPE next_cpp_comment(char ch)
+ *	double wall_clock(void)
  * DESCRIPTION
- *	Determines the next stat if in CppComment state.
+ *	Reads a monotonic clock for timing, so that time spent waiting for
+ *	I/O is included, unlike the processor time of clock().
  * PARAMETERS
- *	char ch - a character from the buffer containing the line of
- * 		  code being examined.
+ *	None
  * RETURN VALUE
- *	Returns the new state.
- * SIDE EFFECTS
- *	None known
- * LIMITATIONS
- *	None known
+ *	The time in seconds from an arbitrary start
  */
-STATETYPE next_cpp_comment(char ch)
+double wall_clock(void)
 {
-    	STATETYPE st;
+#ifdef _WIN32
+	LARGE_INTEGER count, freq;
 
-    	if ( ch == '\n' )
-        	st = NewLineNC;
-    	else
-    		st = CppComment;
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&freq);
+	return (double)count.QuadPart / (double)freq.QuadPart;
+#else
+	struct timespec ts;
 
-    	return st;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
 }
 
 /*
  * FUNCTION
- *	STATETYPE next_comment(char ch)
+ *	void observe_stage(STAGE stage, double seconds)
  * DESCRIPTION
- *	Determines the next state if in Comment state.
+ *	Adds the time taken by one stage of counting a file to the latency
+ *	histogram of the stage, if --prometheus was given.
  * PARAMETERS
- *	char ch - a character from the buffer containing the line of
- * 		  code being examined.
+ *	STAGE stage - StageRead, StageScan or StageFormat
+ *	double seconds - wall clock time taken, from wall_clock()
  * RETURN VALUE
- *	Returns the new state.
- * SIDE EFFECTS
- *	None known
- * LIMITATIONS
- *	None known
+ *	None
  */
-STATETYPE next_comment(char ch)
+void observe_stage(STAGE stage, double seconds)
 {
-	STATETYPE st;
+	static const double bounds[LATENCY_BUCKETS] = LATENCY_BOUNDS;
+	struct latency *lat = &prom.stage[stage];
+	int n;
 
-	if ( ch == '*' )
-		st = PosEndComment;
-	else
-		st = Comment;
+	if ( opts.prom_file == NULL )
+		return;
+	for ( n = 0; n < LATENCY_BUCKETS && seconds > bounds[n]; n++ )
+		;
+	lat->buckets[n]++;
+	lat->count++;
+	lat->sum += seconds;
+}
 
-	return st;
+/*
+ * FUNCTION
+ *	void count_metrics(struct file_data *rec)
+ * DESCRIPTION
+ *	Adds a counted file to the --prometheus counters.
+ * PARAMETERS
+ *	struct file_data *rec - totals of the file
+ * RETURN VALUE
+ *	None
+ */
+void count_metrics(struct file_data *rec)
+{
+	prom.files++;
+	prom.bytes += rec->bytes;
+	prom.lines += rec->lines;
 }
 
 /*
  * FUNCTION
- *	STATETYPE next_pos_end_comment(char ch)
+ *	void update_metrics(int final)
  * DESCRIPTION
- *	Determines the next state if in PosEndComment state.
+ *	Rewrites the --prometheus metrics file when --prometheus-interval
+ *	seconds have passed since it was last written, and at the end of the
+ *	run.
  * PARAMETERS
- *	char ch - a character from the buffer containing the line of
- * 		  code being examined.
+ *	int final - non-zero at the end of the run
  * RETURN VALUE
- *	Returns the new state.
- * SIDE EFFECTS
- *	None known
- * LIMITATIONS
- *	None known
+ *	None
  */
-STATETYPE next_pos_end_comment(char ch)
+void update_metrics(int final)
 {
-	STATETYPE st;
+	time_t now;
 
-	switch (ch)
+	if ( opts.prom_file == NULL )
+		return;
+	now = time(NULL);
+	if ( final || prom.written == 0 || difftime(now, prom.written) >= opts.prom_interval )
 	{
-		case '/':
-			st = EndComment;
-			break;
-		case '*':
-			st = PosEndComment;
-			break;
-		default:
-			st = Comment;
-			break;
+		write_metrics(opts.prom_file);
+		prom.written = now;
 	}
-
-	return st;
 }
 
 /*
  * FUNCTION
- *	STATETYPE next_comp_dir(char ch)
+ *	void write_metrics(char metrics_file[])
  * DESCRIPTION
- *	Determines the next state if in CompDir state.
+ *	Writes the counters in Prometheus text exposition format to a
+ *	temporary file and renames it over the metrics file, so a reader
+ *	never sees a partly written file.
  * PARAMETERS
- *	char ch - a character from the buffer containing the line of
- * 		  code being examined.
+ *	char metrics_file[] - name of the metrics file
  * RETURN VALUE
- *	Returns the new state.
- * SIDE EFFECTS
- *	None known
- * LIMITATIONS
- *	None known
+ *	None, exits on error
  */
-STATETYPE next_comp_dir(char ch)
+void write_metrics(char metrics_file[])
 {
-	STATETYPE st;
+	char *tmp_file;
+	FILE *mp;
 
-	if (ch == '\n')
-		st = NewLine;
-	else
-		st = CompDir;
+	tmp_file = malloc(strlen(metrics_file) + 5);
+	if ( tmp_file == NULL )
+	{
+		fprintf(stderr, "Out of space\n");
+		exit(1);
+	}
+	sprintf(tmp_file, "%s.tmp", metrics_file);
 
-	return st;
+	mp = fopen(tmp_file, "w");
+	if ( mp == NULL )
+	{
+		fprintf(stderr, "Cannot create %s\n", tmp_file);
+		exit(1);
+	}
+	fprintf(mp, "# HELP fnloc_files_total Source code files counted.\n");
+	fprintf(mp, "# TYPE fnloc_files_total counter\n");
+	fprintf(mp, "fnloc_files_total %.0f\n", prom.files);
+	fprintf(mp, "# HELP fnloc_bytes_total Bytes of source code counted.\n");
+	fprintf(mp, "# TYPE fnloc_bytes_total counter\n");
+	fprintf(mp, "fnloc_bytes_total %.0f\n", prom.bytes);
+	fprintf(mp, "# HELP fnloc_lines_total Physical lines of source code counted.\n");
+	fprintf(mp, "# TYPE fnloc_lines_total counter\n");
+	fprintf(mp, "fnloc_lines_total %.0f\n", prom.lines);
+	fprintf(mp, "# HELP fnloc_cache_hits_total Blobs found already counted.\n");
+	fprintf(mp, "# TYPE fnloc_cache_hits_total counter\n");
+	fprintf(mp, "fnloc_cache_hits_total %.0f\n", prom.cache_hits);
+	fprintf(mp, "# HELP fnloc_cache_misses_total Blobs counted for the first time.\n");
+	fprintf(mp, "# TYPE fnloc_cache_misses_total counter\n");
+	fprintf(mp, "fnloc_cache_misses_total %.0f\n", prom.cache_misses);
+	fprintf(mp, "# HELP fnloc_stage_seconds Elapsed time taken by each stage of counting a file.\n");
+	fprintf(mp, "# TYPE fnloc_stage_seconds histogram\n");
+	print_latency(mp, "read", &prom.stage[StageRead]);
+	print_latency(mp, "scan", &prom.stage[StageScan]);
+	print_latency(mp, "format", &prom.stage[StageFormat]);
+	fprintf(mp, "# HELP fnloc_files_queued Files waiting to be counted.\n");
+	fprintf(mp, "# TYPE fnloc_files_queued gauge\n");
+	fprintf(mp, "fnloc_files_queued %d\n", progress.found - progress.done);
+	fprintf(mp, "# HELP fnloc_memory_bytes Memory holding results, as limited by --max-memory.\n");
+	fprintf(mp, "# TYPE fnloc_memory_bytes gauge\n");
+	fprintf(mp, "fnloc_memory_bytes %ld\n", spill.used);
+	fprintf(mp, "# HELP fnloc_spilled_runs Sorted runs of functions in the spill file.\n");
+	fprintf(mp, "# TYPE fnloc_spilled_runs gauge\n");
+	fprintf(mp, "fnloc_spilled_runs %d\n", spill.run_count);
+	if ( ferror(mp) )
+	{
+		fprintf(stderr, "Cannot write %s\n", tmp_file);
+		exit(1);
+	}
+	if ( fclose(mp) != 0 )
+	{
+		fprintf(stderr, "Cannot write %s\n", tmp_file);
+		exit(1);
+	}
+
+#ifdef _WIN32
+	/* rename() does not replace an existing file on Windows */
+	remove(metrics_file);
+#endif
+	if ( rename(tmp_file, metrics_file) != 0 )
+	{
+		fprintf(stderr, "Cannot rename %s to %s\n", tmp_file, metrics_file);
+		exit(1);
+	}
+	free(tmp_file);
 }
 
 /*
  * FUNCTION
- *	STATETYPE next_line_of_code(char ch)
+ *	void print_latency(FILE *mp, char stage[], struct latency *lat)
  * DESCRIPTION
- *	Determines the next state if in LineOfCode state.
+ *	Writes the cumulative buckets, sum and count of a latency histogram.
  * PARAMETERS
- *	char ch - a character from the buffer containing the line of
- * 		  code being examined.
+ *	FILE *mp - the metrics file
+ *	char stage[] - value of the stage label
+ *	struct latency *lat - the histogram
  * RETURN VALUE
- *	Returns the new state.
- * SIDE EFFECTS
- *	None known
- * LIMITATIONS
- *	None known
- * MODIFICATION HISTORY
- *	09-03-18 Removed case ',' and case ':'
+ *	None
  */
-STATETYPE next_line_of_code(char ch)
+void print_latency(FILE *mp, char stage[], struct latency *lat)
 {
-	STATETYPE st;
+	static const double bounds[LATENCY_BUCKETS] = LATENCY_BOUNDS;
+	double total = 0.0;
+	int n;
 
-	switch (ch)
+	for ( n = 0; n < LATENCY_BUCKETS; n++ )
 	{
-		case '}':
-			st = CloseBracket2;
-			break;
-		case '{':
-		case ';':
-			st = PosEOL;
-			break;
-		default:
-			st = LineOfCode;
-			break;
+		total += lat->buckets[n];
+		fprintf(mp, "fnloc_stage_seconds_bucket{stage=\"%s\",le=\"%g\"} %.0f\n",
+			stage, bounds[n], total);
 	}
-
-	return st;
+	fprintf(mp, "fnloc_stage_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %.0f\n",
+		stage, lat->count);
+	fprintf(mp, "fnloc_stage_seconds_sum{stage=\"%s\"} %.6f\n", stage, lat->sum);
+	fprintf(mp, "fnloc_stage_seconds_count{stage=\"%s\"} %.0f\n", stage, lat->count);
 }
 
 /*
  * FUNCTION
- *	STATETYPE next_open_bracket(char ch)
+ *	int self_test(int cases, unsigned long seed)
  * DESCRIPTION
- *	Determines the next state if in OpenBracket state.
+ *	Checks the ways count_file() reads source code against the reference
+ *	scanner, the original fgets() loop of FnLoC. Random and mutated C-like
+ *	sources are counted by each engine (a stream, memory, \r\n and \r
+ *	line endings, UTF-16, the lexer used by --metrics, a file opened by
+ *	open_source() and a pipe read in small pieces) and the LOC,
+ *	function records and final line state must match the reference.
+ *	Every source after the first of each five is counted with --braces,
+ *	--dead-code or --style allman or gnu, which the reference scanner
+ *	does not know; those are counted from memory first, and the other
+ *	engines must match that. The first source that does not match is
+ *	saved to fnloc-selftest-<seed>-<source>.c.
  * PARAMETERS
- *	char ch - a character from the buffer containing the line of
- * 		  code being examined.
+ *	int cases - number of sources to check
+ *	unsigned long seed - seed of the random sources
  * RETURN VALUE
- *	Returns the new state.
- * SIDE EFFECTS
- *	None known
- * LIMITATIONS
- *	None known
+ *	0 if every engine matched the reference, otherwise 1
  */
-STATETYPE next_open_bracket(char ch)
+int self_test(int cases, unsigned long seed)
 {
-	STATETYPE st;
+	static char *engines[] = { "stream", "memory", "crlf", "cr", "utf16", "lexer",
+				   "file", "pipe" };
+	static char *modes[] = { "", " --braces", " --dead-code", " --style allman",
+				 " --style gnu" };
+	struct ref_result ref;
+	struct text src, alt;
+	struct input in;
+	char engine[32];	/* the engine and the options of the source */
+	char saved[64];		/* file the failing source is saved to */
+	unsigned long first_seed = seed;
+	FILE *sp;
+	long k;
+	int n, e, mode;
+	int failed = 0;
 
-	switch (ch)
+	memset(&ref, 0, sizeof(ref));
+	memset(&src, 0, sizeof(src));
+	memset(&alt, 0, sizeof(alt));
+	opts.special = SpecialCount;
+	opts.line_map = NULL;
+
+	for ( n = 0; n < cases && !failed; n++ )
 	{
-		case '\n':
-			st = NewLine;
-			break;
-		case '}':
-			st = CloseBracket2;
-			break;
-		default:
-			st = LineOfCode;
-			break;
+		src.len = 0;
+		make_case(&src, &seed);
+
+		sp = tmpfile();
+		if ( sp == NULL || fwrite(src.data, 1, src.len, sp) != (size_t)src.len )
+		{
+			fprintf(stderr, "Cannot create a temporary file\n");
+			return 1;
+		}
+		rewind(sp);
+
+		mode = n % (int)(sizeof(modes) / sizeof(modes[0]));
+		opts.braces = mode == 1;
+		opts.dead_code = mode == 2;
+		opts.style = mode == 3 ? StyleAllman : (mode == 4 ? StyleGnu : StyleKR);
+		opts.metrics = 0;
+		if ( mode == 0 )
+			reference_count(sp, &ref);
+		else
+		{
+			memset(&in, 0, sizeof(in));
+			in.fd = -1;
+			in.data = src.data;
+			in.size = src.len;
+			keep_result(count_file(&in, "memory"), &ref);
+			head = free_list(head);
+			last = NULL;
+			files = free_files(files);
+			last_file = NULL;
+		}
+
+		for ( e = 0; e < (int)(sizeof(engines) / sizeof(engines[0])) && !failed; e++ )
+		{
+			alt.len = 0;
+			for ( k = 0; k < src.len; k++ )
+				switch (e)
+				{
+				case 2:
+					text_printf(&alt, src.data[k] == '\n' ? "\r\n" : "%c", src.data[k]);
+					break;
+				case 3:
+					text_printf(&alt, "%c", src.data[k] == '\n' ? '\r' : src.data[k]);
+					break;
+				case 4:
+					if ( k == 0 )
+						text_printf(&alt, "\xff\xfe");
+					text_printf(&alt, "%c", src.data[k]);
+					alt.data[alt.len++] = '\0';
+					break;
+				}
+
+			memset(&in, 0, sizeof(in));
+			in.fd = -1;
+			if ( e == 0 )
+			{
+				rewind(sp);
+				in.fp = sp;
+			}
+			else if ( e >= 2 && e <= 4 )
+			{
+				in.data = alt.data;
+				in.size = alt.len;
+			}
+			else if ( e >= 6 )
+			{
+				/* short reads of 1 to 61 bytes, as from a slow pipe */
+				if ( !open_case(&in, &src, e == 7 ? 1 + (n * 7 + src.len) % 61 : 0) )
+					return 1;
+			}
+			else
+			{
+				in.data = src.data;
+				in.size = src.len;
+			}
+			opts.metrics = e == 5;
+
+			sprintf(engine, "%s%s", engines[e], modes[mode]);
+			if ( !check_engine(engine, &in, &ref, n) )
+				failed = 1;
+			if ( in.fd >= 0 )
+				close_source(&in);
+			head = free_list(head);
+			last = NULL;
+			files = free_files(files);
+			last_file = NULL;
+		}
+		fclose(sp);
+
+		if ( failed )
+		{
+			sprintf(saved, "fnloc-selftest-%lu-%d.c", first_seed, n);
+			sp = fopen(saved, "wb");
+			if ( sp != NULL )
+			{
+				fwrite(src.data, 1, src.len, sp);
+				fclose(sp);
+				fprintf(stderr, "The source was saved to %s\n", saved);
+			}
+		}
 	}
 
-	return st;
+	printf("Self-test: %d sources, %d engines, %d option sets, %s\n", n,
+	       (int)(sizeof(engines) / sizeof(engines[0])),
+	       (int)(sizeof(modes) / sizeof(modes[0])),
+	       failed ? "FAILED" : "all match");
+	free(ref.fns);
+	free(src.data);
+	free(alt.data);
+	return failed;
 }
 
 /*
  * FUNCTION
- *	STATETYPE next_close_bracket1(char ch)
+ *	unsigned long next_random(unsigned long *seed)
  * DESCRIPTION
- *	Determines the next state if in CloseBracket1 state.
+ *	A 32 bit xorshift random number generator, so that the sources of
+ *	--self-test and the files picked by --sample are the same with every
+ *	C library.
  * PARAMETERS
- *	char ch - a character from the buffer containing the line of
- * 		  code being examined.
+ *	unsigned long *seed - the state of the generator
  * RETURN VALUE
- *	Returns the new state.
- * SIDE EFFECTS
- *	None known
- * LIMITATIONS
- *	None known
+ *	The next random number
  */
-STATETYPE next_close_bracket1(char ch)
+unsigned long next_random(unsigned long *seed)
 {
-	STATETYPE st;
+	unsigned long x = *seed & 0xffffffffUL;
 
-	if ( ch == '\n' )
-		st = NewLineNC;
-	else
-		st = CloseBracket2;
+	if ( x == 0 )
+		x = 2463534242UL;
+	x ^= (x << 13) & 0xffffffffUL;
+	x ^= x >> 17;
+	x ^= (x << 5) & 0xffffffffUL;
+	*seed = x;
+	return x;
+}
 
-	return st;
+/*
+ * FUNCTION
+ *	void make_case(struct text *src, unsigned long *seed)
+ * DESCRIPTION
+ *	Builds a random C-like source from fragments of code, comments,
+ *	directives, braces and long lines, then sometimes mutates it by
+ *	changing, deleting or repeating bytes. Every byte is printable ASCII,
+ *	a tab or a newline. Some sources are larger than an input block.
+ * PARAMETERS
+ *	struct text *src - receives the source
+ *	unsigned long *seed - the state of the random number generator
+ * RETURN VALUE
+ *	None
+ */
+void make_case(struct text *src, unsigned long *seed)
+{
+	static char *fragments[] = {
+		"int f(int x)\n", "static void g(void)\n", "char *name(char *s,\n",
+		"\tint y)\n", "{\n", "}\n", "{", "}", "};\n", "\n", "\n\n", " ",
+		"\t", "x = y;", "return 0;\n", "if (a) {", "} else {", "for (;;)\n",
+		"struct s {\n", "/* comment */", "/*", "*/", "// line\n", "//",
+		"#include <stdio.h>\n", "#define X 1\n", "\"string\"", "'c'", "a",
+		"(", ")", ";", "/", "*", "#", "\\\n", "  {\n", "    }\n",
+		"#if 0\n", "#ifdef X\n", "#else\n", "#endif\n", "namespace n {\n",
+		"extern \"C\" {\n", "class c {\n", "int\n", "f (void)\n",
+		"enum e {\n", "x = { 1 };\n"
+	};
+	int nfrag = sizeof(fragments) / sizeof(fragments[0]);
+	long size = next_random(seed) % 8 == 0 ? 20000 : next_random(seed) % 2000;
+	long at, len, k;
+	int n;
+
+	while ( src->len < size )
+	{
+		if ( next_random(seed) % 40 == 0 )
+		{
+			/* a long line read in several chunks */
+			len = 100 + next_random(seed) % 300;
+			for ( k = 0; k < len; k++ )
+				text_printf(src, "%c", (int)('a' + next_random(seed) % 26));
+			text_printf(src, "\n");
+		}
+		else
+			text_printf(src, "%s", fragments[next_random(seed) % nfrag]);
+	}
+
+	if ( next_random(seed) % 2 == 0 )
+		for ( n = next_random(seed) % 8; n > 0 && src->len > 0; n-- )
+		{
+			at = next_random(seed) % src->len;
+			switch (next_random(seed) % 3)
+			{
+			case 0:
+				k = next_random(seed) % 97;
+				src->data[at] = k < 95 ? (char)(' ' + k) : (k == 95 ? '\t' : '\n');
+				break;
+			case 1:
+				len = next_random(seed) % (src->len - at) + 1;
+				memmove(src->data + at, src->data + at + len, src->len - at - len);
+				src->len -= len;
+				break;
+			case 2:
+				len = next_random(seed) % 64 + 1;
+				if ( len > src->len - at )
+					len = src->len - at;
+				for ( k = 0; k < len; k++ )
+					text_printf(src, "%c", src->data[at + k]);
+				break;
+			}
+		}
+	if ( src->data != NULL )
+		src->data[src->len] = '\0';
 }
 
 /*
  * FUNCTION
- *	STATETYPE next_close_bracket2(char ch)
+ *	int open_case(struct input *in, struct text *src, long chunk)
  * DESCRIPTION
- *	Determines the next state if in CloseBracket2 state.
+ *	Opens a --self-test source to be read with read(): written to a
+ *	tmpfile() read as open_source() reads the files it opens, or fed to a
+ *	pipe a chunk at a time by read_source(), so that every read() of the
+ *	pipe returns fewer bytes than were asked for.
  * PARAMETERS
- *	char ch - a character from the buffer containing the line of
- * 		  code being examined.
+ *	struct input *in - receives the open source
+ *	struct text *src - the source
+ *	long chunk - bytes put in the pipe before each read(), 0 to use a file
  * RETURN VALUE
- *	Returns the new state.
- * SIDE EFFECTS
- *	None known
- * LIMITATIONS
- *	None known
+ *	1 if the source was opened, 0 on error
  */
-STATETYPE next_close_bracket2(char ch)
+int open_case(struct input *in, struct text *src, long chunk)
 {
-	STATETYPE st;
+	FILE *tp;
+	int fds[2];
+	int fd = -1;
 
-	if ( ch == ';' )
-		st = PosEOL;
-	else
-		st = LineOfCode;
+	if ( chunk == 0 )
+	{
+		/* the descriptor outlives the stream, which deletes the file */
+		tp = tmpfile();
+		if ( tp == NULL || (long)fwrite(src->data, 1, src->len, tp) != src->len
+		     || fflush(tp) != 0 || (fd = dup(fileno(tp))) < 0
+		     || lseek(fd, 0L, SEEK_SET) != 0 )
+		{
+			fprintf(stderr, "Cannot create a temporary file\n");
+			if ( tp != NULL )
+				fclose(tp);
+			if ( fd >= 0 )
+				close(fd);
+			return 0;
+		}
+		fclose(tp);
+		start_source(in, fd, "file");
+		return 1;
+	}
 
-	return st;
-}
+#ifdef _WIN32
+	if ( _pipe(fds, BLOCK_LEN, O_BINARY) != 0 )
+#else
+	if ( pipe(fds) != 0 )
+#endif
+	{
+		fprintf(stderr, "Cannot create a pipe\n");
+		return 0;
+	}
 
+	memset(in, 0, sizeof(*in));
+	in->fd = fds[0];
+	in->expect = -1;
+	in->name = "pipe";
+	in->data = in->block;
+	in->feed = src->data;
+	in->feed_left = src->len;
+	in->feed_fd = fds[1];
+	in->chunk = chunk;
+	if ( src->len == 0 )
+		feed_pipe(in);
+	return 1;
+}
 
 /*
  * FUNCTION
- *	STATETYPE next_pos_eol(char ch)
+ *	void feed_pipe(struct input *in)
  * DESCRIPTION
- *	Determines the next state if in PosEOL state.
+ *	Writes the next chunk of a --self-test source to its pipe, closing
+ *	the pipe after the last one.
  * PARAMETERS
- *	char ch - a character from the buffer containing the line of
- * 		  code being examined.
+ *	struct input *in - the source being read from the pipe
  * RETURN VALUE
- *	Returns the new state.
- * SIDE EFFECTS
- *	None known
- * LIMITATIONS
- *	None known
+ *	None
  */
-STATETYPE next_pos_eol(char ch)
+void feed_pipe(struct input *in)
 {
-	STATETYPE st;
+	long len = in->feed_left < in->chunk ? in->feed_left : in->chunk;
 
-	switch (ch)
+	if ( len > 0 && write(in->feed_fd, in->feed, len) != len )
+		fprintf(stderr, "Cannot write to a pipe\n");
+	in->feed += len;
+	in->feed_left -= len;
+	if ( in->feed_left == 0 )
 	{
-		case '\n':
-			st = NewLine;
-			break;
-		case ' ':
-		case '\t':
-			st = PosEOL;
-			break;
-		case '/':
-			st = InlineComment;
-			break;
-		default:
-			st = LineOfCode;
-			break;
+		close(in->feed_fd);
+		in->feed = NULL;
 	}
-
-	return st;
 }
 
 /*
  * FUNCTION
- *	STATETYPE next_inline_comment(char ch)
+ *	void reference_count(FILE *sp, struct ref_result *ref)
  * DESCRIPTION
- *	Determines the next state if in InlineComment state.
+ *	The reference scanner: the counting loop of the original FnLoC, which
+ *	reads the source with fgets() and runs the line state machine one
+ *	character at a time. It must not be changed to match count_file().
  * PARAMETERS
- *	char ch - a character from the buffer containing the line of
- * 		  code being examined.
+ *	FILE *sp - the source code, at its start
+ *	struct ref_result *ref - receives the results
  * RETURN VALUE
- *	Returns the new state.
- * SIDE EFFECTS
- *	None known
- * LIMITATIONS
- *	None known
+ *	None
  */
-STATETYPE next_inline_comment(char ch)
+void reference_count(FILE *sp, struct ref_result *ref)
 {
-	STATETYPE st;
+	char buffer[BUF_LEN];
+	char fn_name1[BUF_LEN];
+	char fn_name2[BUF_LEN];
+	int i;
+	int fn_loc = 0;
+	STATETYPE state = NewLine;
+	FNSTATETYPE fn_state = NotFunction;
 
-	if ( ch == '\n' )
-		st = NewLine;
-	else
-		st = InlineComment;
+	strcpy(fn_name1, "");
+	strcpy(fn_name2, "");
+	ref->prg_loc = ref->fn_count = ref->fn_loc = ref->count = 0;
 
-	return st;
+	while ( !feof(sp) )
+	{
+		if ( fgets(buffer, BUF_LEN, sp) )
+		{
+			for ( i= 0; i < strlen(buffer); i++ )
+			{
+				switch (state)
+				{
+				case (NewLine) :
+					state = next_new_line(buffer[i]);
+					break;
+				case (NewLineNC) :
+					break;
+				case (PosComment) :
+					state = next_pos_comment(buffer[i]);
+					break;
+				case (CppComment) :
+					state = next_cpp_comment(buffer[i]);
+					break;
+				case (Comment) :
+					state = next_comment(buffer[i]);
+					break;
+				case (PosEndComment) :
+					state = next_pos_end_comment(buffer[i]);
+					break;
+				case (EndComment) :
+					state = NewLineNC;
+					break;
+				case (CompDir) :
+					state = next_comp_dir(buffer[i]);
+					break;
+				case (LineOfCode) :
+					state = next_line_of_code(buffer[i]);
+					break;
+				case (OpenBracket) :
+					state = next_open_bracket(buffer[i]);
+					break;
+				case (CloseBracket1) :
+					state = next_close_bracket1(buffer[i]);
+					break;
+				case (CloseBracket2) :
+					state = next_close_bracket2(buffer[i]);
+					break;
+				case (PosEOL) :
+					state = next_pos_eol(buffer[i]);
+					break;
+				case (InlineComment) :
+					state = next_inline_comment(buffer[i]);
+					break;
+				}	/* end switch(state) */
+			}	/* end for loop */
+
+			if ( isalpha(buffer[0]) )
+			{
+				fn_state = PosFunction;
+				strcpy(fn_name1, buffer);
+				strcpy(fn_name2, "");
+				fn_loc = 0;
+			}
+
+			if ( fn_state == PosFunction )
+			{
+				switch (buffer[0])
+				{
+					case '{':
+						fn_state = IsFunction;
+						ref->fn_count++;
+						break;
+					case ' ':
+					case '\t':
+						strcpy(fn_name2, buffer);
+						break;
+					case '}':
+						fn_state = NotFunction;
+						strcpy(fn_name1, "");
+						strcpy(fn_name2, "");
+				}
+			}
+
+			if ( state == NewLine )
+				ref->prg_loc++;
+
+			if ( state == NewLine && fn_state == IsFunction )
+			{
+				fn_loc++;
+				ref->fn_loc++;
+			}
+
+			if ( state == NewLineNC )
+				state = NewLine;
+
+			if ( fn_state == IsFunction && buffer[0] == '}' )
+			{
+				if ( ref->count == ref->size )
+				{
+					ref->size = ref->size ? ref->size * 2 : 64;
+					ref->fns = realloc(ref->fns, ref->size * sizeof(struct ref_fn));
+					if ( ref->fns == NULL )
+					{
+						fprintf(stderr, "Out of space\n");
+						exit(1);
+					}
+				}
+				strcpy(ref->fns[ref->count].name1, fn_name1);
+				strcpy(ref->fns[ref->count].name2, fn_name2);
+				ref->fns[ref->count++].loc = fn_loc;
+				fn_state = NotFunction;
+				strcpy(fn_name1, "");
+				strcpy(fn_name2, "");
+				fn_loc = 0;
+			}
+		}	/* end if( fgets(... */
+	}	/* end while (!feof(sp)) loop */
+
+	ref->state = state;
 }
 
 /*
  * FUNCTION
- *	void insert_at_end(fn_name, char fn_name2[], fn_loc)
+ *	void keep_result(struct file_data *rec, struct ref_result *ref)
  * DESCRIPTION
- *	inserts data into a singly linked list at the head if it is the first
- *	item, otherwise at the end.
+ *	Keeps the results of count_file() as the results every engine must
+ *	match, for the options the reference scanner does not know.
  * PARAMETERS
- *	char fn_name[]	- character string holding the current function name
- *	char fn_name2[] - character strng holding second line of function name
- *	int fn_loc - integer holding the number of loc in the function
+ *	struct file_data *rec - the file counted
+ *	struct ref_result *ref - receives the results
  * RETURN VALUE
- *	None, inserts data into the linked list
+ *	None, exits if out of memory
  */
-void insert_at_end(char fn_name1[], char fn_name2[], int fn_loc)
+void keep_result(struct file_data *rec, struct ref_result *ref)
 {
-	node *current;
-	current = (node*)malloc(sizeof(node));
+	node *fn;
 
-	if ( current == NULL )
-	{
-		fprintf(stderr, "Out of space\n");
-		exit(1);
-	}
-	else
+	ref->prg_loc = rec->prg_loc;
+	ref->fn_count = rec->fn_count;
+	ref->fn_loc = rec->fn_loc;
+	ref->state = rec->end_state;
+	ref->count = 0;
+	for ( fn = rec->first_fn; fn != NULL; fn = fn->next )
 	{
-		strcpy(current->name1, fn_name1);
-		strcpy(current->name2, fn_name2);
-		current->loc = fn_loc;
-		current->next = NULL;
-
-		if ( head == NULL )
-		{
-			head = current;
-			last = current;
-		}
-		else
+		if ( ref->count == ref->size )
 		{
-			last->next = current;
-			last = current;
+			ref->size = ref->size ? ref->size * 2 : 64;
+			ref->fns = realloc(ref->fns, ref->size * sizeof(struct ref_fn));
+			if ( ref->fns == NULL )
+			{
+				fprintf(stderr, "Out of space\n");
+				exit(1);
+			}
 		}
+		strcpy(ref->fns[ref->count].name1, fn->name1);
+		strcpy(ref->fns[ref->count].name2, fn->name2);
+		ref->fns[ref->count++].loc = fn->loc;
 	}
 }
 
 /*
  * FUNCTION
- *	void delete_list(node *head)
+ *	int check_engine(char engine[], struct input *in, struct ref_result *ref,
+ *			 int n)
  * DESCRIPTION
- *	frees the memory allocated for the list
+ *	Counts a source with count_file() and compares the results with the
+ *	reference scanner, displaying the first difference.
  * PARAMETERS
- *	node *head - the head of the linked list
+ *	char engine[] - name of the way the source is read
+ *	struct input *in - the source
+ *	struct ref_result *ref - results of the reference scanner
+ *	int n - number of the source
  * RETURN VALUE
- *	None
+ *	1 if the results match, otherwise 0
  */
-node *free_list(node *head)
+int check_engine(char engine[], struct input *in, struct ref_result *ref,
+		 int n)
 {
-	node *tmpPtr = head;
-	node *followPtr;
+	struct file_data *rec;
+	node *fn;
+	int k;
 
-	while ( tmpPtr != NULL )
+	rec = count_file(in, engine);
+	if ( rec->prg_loc != ref->prg_loc || rec->fn_count != ref->fn_count
+	     || rec->fn_loc != ref->fn_loc || rec->end_state != ref->state )
 	{
-		followPtr = tmpPtr;
-		tmpPtr = tmpPtr->next;
-		free(followPtr);
+		printf("Source %d, %s: LOC %d, functions %d, function LOC %d, state %d;"
+		       " expected %d, %d, %d, %d\n", n, engine, rec->prg_loc,
+		       rec->fn_count, rec->fn_loc, rec->end_state, ref->prg_loc,
+		       ref->fn_count, ref->fn_loc, ref->state);
+		return 0;
 	}
-	return NULL;
+
+	for ( k = 0, fn = rec->first_fn; k < ref->count; k++, fn = fn->next )
+		if ( fn == NULL || fn->loc != ref->fns[k].loc
+		     || strcmp(fn->name1, ref->fns[k].name1) != 0
+		     || strcmp(fn->name2, ref->fns[k].name2) != 0 )
+		{
+			printf("Source %d, %s: function %d differs from %s", n, engine,
+			       k + 1, ref->fns[k].name1);
+			return 0;
+		}
+	if ( fn != NULL )
+	{
+		printf("Source %d, %s: extra function %s", n, engine, fn->name1);
+		return 0;
+	}
+	return 1;
 }
 
 /*
@@ -731,31 +7082,65 @@ node *free_list(node *head)
  */
 void print_intro(char source[])
 {
-	printf("\nFnLoC 2.2.1\n");
+	print_banner();
+	print_title(source);
+}
+
+/*
+ * FUNCTION
+ *	void print_banner(void)
+ * DESCRIPTION
+ *	displays the program name, version, copyright and license
+ * PARAMETERS
+ *	None
+ * RETURN VALUE
+ *	None
+ */
+void print_banner(void)
+{
+	printf("\nFnLoC %s\n", FNLOC_VERSION);
 	printf("Copyright 2018, Richard B. Romig\n");
 	printf("Licensed under the GNU General Public License, version 2\n\n");
+}
+
+/*
+ * FUNCTION
+ *	void print_title(char source[])
+ * DESCRIPTION
+ *	displays the name of the source code file ahead of its data
+ * PARAMETERS
+ *	char source[] - character string containing the name of the source
+ *			code file
+ * RETURN VALUE
+ *	None
+ */
+void print_title(char source[])
+{
 	printf("Lines of code data for %s\n\n", source);
 }
 
 /*
  * FUNCTION
- *	void print_fn_data(char source[], int fn_count, int prg_loc)
+ *	void print_fn_data(char source[], node *first, int fn_count, int prg_loc)
  * DESCRIPTION
- *	displays function named loc contained in the function.
+ *	displays function named loc contained in the function, and with
+ *	--positions its starting and ending lines and byte offsets.
  *	if there are no functions displays a message to that effect and
  *	displays total lines of coded found in the source file.
  * PARAMETERS
  *	char source[] - character string containing the name of the source
  *			code file - argv[1]
+ *	node *first - the first function of the file in the list
  *	int fn_count - number of functions found
  *	int prg_loc - total lines of code counted in the source file
  * RETURN VALUE
  *	None
  */
-void print_fn_data(char source[], int fn_count, int prg_loc)
+void print_fn_data(char source[], node *first, int fn_count, int prg_loc)
 {
 	node *current;
-	current = head;
+	int n;
+	current = first;
 
 	if ( fn_count == 0 )
 	{
@@ -765,17 +7150,65 @@ void print_fn_data(char source[], int fn_count, int prg_loc)
 	else
 	{
 		printf("Functions:\n");
-		while ( current != NULL )
+		for ( n = 0; n < fn_count && current != NULL; n++ )
 		{
 			printf("%s", current->name1);
 			if ( strcmp(current->name2, "") != 0 )
 				printf("%s", current->name2);
-			printf("LOC:\t%4d\n", current->loc);
+			printf("LOC:\t%4d", current->loc);
+			if ( opts.metrics )
+				printf("\tBranches: %d\tNesting: %d\tReturns: %d",
+				       current->metrics.branches, current->metrics.depth,
+				       current->metrics.returns);
+			printf("\n");
+			if ( opts.positions )
+				printf("Lines:\t%d-%d\tBytes:\t%ld-%ld\n",
+				       current->pos.start_line, current->pos.end_line,
+				       current->pos.start_offset, current->pos.end_offset);
 			current = current->next;
 		}
 	}
 }
 
+/*
+ * FUNCTION
+ *	void print_totals(void)
+ * DESCRIPTION
+ *	displays a combined summary of the loc data of all the files counted.
+ * PARAMETERS
+ *	None
+ * RETURN VALUE
+ *	None
+ */
+void print_totals(void)
+{
+	struct file_data *file;
+	int file_count = spill.file_count, fn_count = spill.fn_count;
+	int total_fn_loc = spill.fn_loc, prg_loc = spill.prg_loc;
+	int skipped = spill.skipped, dead_loc = spill.dead_loc;
+
+	for ( file = files; file != NULL; file = file->next )
+	{
+		skipped += file->skipped;
+		dead_loc += file->dead_loc;
+		file_count++;
+		fn_count += file->fn_count;
+		total_fn_loc += file->fn_loc;
+		prg_loc += file->prg_loc;
+	}
+
+	printf("Combined summary:\n");
+	printf("Number of files:     %4d\n", file_count);
+	if ( skipped != 0 )
+		printf("Files not counted:   %4d\n", skipped);
+	printf("Number of functions: %4d\n", fn_count);
+	printf("Function LOC:        %4d\n", total_fn_loc);
+	printf("Non-function LOC:    %4d\n", prg_loc - total_fn_loc);
+	printf("Total Program LOC:   %4d\n\n", prg_loc);
+	if ( opts.dead_code )
+		printf("Dead code lines:     %4d\n\n", dead_loc);
+}
+
 /*
  * FUNCTION
  *	void print_summary(int fn_count, int total_fn_loc, int prg_loc)
@@ -813,8 +7246,57 @@ void print_summary(int fn_count, int total_fn_loc, int prg_loc)
 */
 void show_usage(char p_name[])
 {
- 	printf("\tUsage: %s filename\n", p_name);
+ 	printf("\tUsage: %s [-p] [--index idxfile] [--line-map mapfile] filename|dir...\n", p_name);
+ 	printf("\t       %s [-p] [--index idxfile] @listfile\n", p_name);
+ 	printf("\t       %s [-p] [--index idxfile] -0 < names\n", p_name);
+ 	printf("\t       %s --find idxfile function\n", p_name);
+ 	printf("\t       %s --over idxfile loc\n", p_name);
+ 	printf("\t       %s --compare old new\n", p_name);
+ 	printf("\t       %s --history stream\n", p_name);
+ 	printf("\t       %s --stream\n", p_name);
+ 	printf("\t       %s --self-test [n [seed]]\n", p_name);
+ 	printf("\t       %s --tu file [-I dir]... [file...]\n", p_name);
  	printf("\tWhere filename is a C or C++ source code or header file.\n");
+ 	printf("\t@listfile names a file listing one source code file per line.\n");
+ 	printf("\t-0 reads NUL separated file names from standard input.\n");
+ 	printf("\t--special skip|quick|count handles binary, generated and\n");
+ 	printf("\t    minified files: skip them, count LOC only, or count as usual.\n");
+ 	printf("\t--marker text adds a marker of generated files.\n");
+ 	printf("\t--minified len sets the average line length of minified files.\n");
+ 	printf("\t--style [pattern=]kr|allman|gnu sets the coding style of all\n");
+ 	printf("\t\tfiles, or of the files matching pattern (linux is kr).\n");
+ 	printf("\t--braces finds functions by matching braces, in any brace style\n");
+ 	printf("\t\tand inside namespaces and classes.\n");
+ 	printf("\t-m, --metrics shows the branches, nesting depth and returns\n");
+ 	printf("\t\tof each function.\n");
+ 	printf("\t--dead-code skips and reports code disabled by #if 0.\n");
+ 	printf("\t-U macro also treats code disabled by an undefined macro as dead.\n");
+ 	printf("\t--max-fn-loc n and --max-file-loc n only report functions and files\n");
+ 	printf("\t\tover n LOC and exit with 1 if there are any.\n");
+ 	printf("\t--fail-fast stops at the first file over budget.\n");
+ 	printf("\t--shard i/n counts only the i-th of n shards of the files.\n");
+ 	printf("\t--merge index... displays the combined report of shard indexes.\n");
+ 	printf("\t--sample p estimates the totals from a fraction p (or p%%) of the\n");
+ 	printf("\t\tfiles in each directory; --seed n picks another sample.\n");
+ 	printf("\t--max-memory size[K|M|G] moves results to temporary files\n");
+ 	printf("\t\tto stay under size.\n");
+ 	printf("\t--progress shows the progress of the run on stderr;\n");
+ 	printf("\t\t--progress-fd n writes it to file descriptor n.\n");
+ 	printf("\t--prometheus file writes metrics of the run to file every\n");
+ 	printf("\t\t--prometheus-interval n seconds (15).\n");
+ 	printf("\t--tu counts translation units with the headers they include,\n");
+ 	printf("\t\tfound in the -I directories, counting each header once.\n");
+ 	printf("\t-p, --positions shows the lines and byte offsets of functions.\n");
+ 	printf("\t--index writes a sorted function index to idxfile.\n");
+ 	printf("\t--line-map writes the class of every line to mapfile.\n");
+ 	printf("\t--find looks up a function by name in idxfile.\n");
+ 	printf("\t--over lists the functions in idxfile with more than loc LOC.\n");
+ 	printf("\t--compare shows the LOC changes between two indexes, source files,\n");
+ 	printf("\t\tdirectories, @listfiles or -0 lists.\n");
+ 	printf("\t--history counts each commit of a blob stream, - for stdin.\n");
+ 	printf("\t--stream counts framed source code records read from stdin.\n");
+ 	printf("\t--self-test [n [seed]] checks the ways of reading source code\n");
+ 	printf("\t\tagainst the original scanner with n random sources.\n");
  	printf("\tSee README for information regarding style requirements\n");
  	printf("\tand limitations.\n\n");
 }
@@ -1,5 +1,5 @@
 /*
- * fnloc.h - header file for fnloc.c version 2.2.1
+ * fnloc.h - header file for fnloc.c version 2.3.0
  * Copyright (C) 2018  Richard Romig
  *
  * This program is free software; you can redistribute it and/or modify
@@ -18,16 +18,66 @@
  * 6 September 2018
  */
 
+/* Version shown in the program introduction */
+#define FNLOC_VERSION "2.3.0"
+
 /* Maximum buffer length */
 #define BUF_LEN 128
 
+/* Size of the block read from a source code file at a time */
+#define BLOCK_LEN 8192
+
+/* UTF-16 bytes transcoded at a time, at most 3 UTF-8 bytes per 2 bytes */
+#define WIDE_LEN (BLOCK_LEN / 3 * 2)
+
+/* Maximum length of a file name (Windows MAX_PATH) */
+#define PATH_LEN 260
+
+/* Maximum length of a commit or blob id in a history stream */
+#define ID_LEN 72
+
+/* Function index file signature */
+#define IDX_MAGIC "FNLOCIX6"
+
+/* Sizes of the function index records in the file */
+#define IDX_HEADER_SIZE 56
+#define IDX_REC_SIZE 72
+#define IDX_LOC_SIZE 8
+#define IDX_FILE_SIZE 36
+
+/* Line map file signature */
+#define LMAP_MAGIC "FNLOCLM1"
+
 FILE *fp;
 
+/*
+ * Location of a function in its source file. Lines are numbered from 1;
+ * start_offset is the byte offset of the first line of the header and
+ * end_offset is the offset just past the line holding the closing brace.
+ */
+struct fn_pos {
+	int start_line;
+	int end_line;
+	long start_offset;
+	long end_offset;
+};
+
+/* complexity of a function, counted between its braces */
+struct fn_metrics {
+	int branches;		/* if, for, while, case, && and || */
+	int depth;		/* deepest nesting of braces inside the function */
+	int returns;		/* return statements */
+};
+
 /* linked list data structures */
 struct fn_data {
-	char name1[BUF_LEN];
-	char name2[BUF_LEN];
+	int header;		/* ID of the interned header */
+	char *name1;		/* header text, owned by the header table */
+	char *name2;
+	char *file;		/* file name, owned by the path table */
+	struct fn_pos pos;
 	int loc;
+	struct fn_metrics metrics;
 	struct fn_data *next;
 };
 
@@ -36,6 +86,535 @@ typedef struct fn_data node;
 node *head;
 node *last;
 
+/*
+ * Function headers are interned so that each distinct header is stored
+ * once however many files it appears in; functions refer to their header
+ * by its ID, the index in list, and two functions have the same header
+ * when their IDs are equal. slots is an open addressing hash table of
+ * header IDs plus one, 0 marking an empty slot.
+ */
+struct header {
+	char *name1;		/* first line of the header */
+	char *name2;		/* second line, or "" */
+	unsigned long hash;
+	int count;		/* functions found with this header */
+};
+
+struct header_table {
+	struct header *list;
+	int count;
+	int size;		/* headers allocated in list */
+	int *slots;
+	int slot_count;		/* a power of 2 */
+};
+
+struct header_table headers;
+
+/*
+ * Source code file names are interned the same way, so a file's record
+ * and all of its functions share one copy of its name, and the function
+ * index stores each name once.
+ */
+struct path {
+	char *name;
+	unsigned long hash;
+	int64_t offset;		/* in the string table of the index being
+				   written, 0 until the name is written */
+};
+
+struct path_table {
+	struct path *list;
+	int count;
+	int size;		/* names allocated in list */
+	int *slots;
+	int slot_count;		/* a power of 2 */
+};
+
+struct path_table paths;
+
+/* Kinds of file found by the pre-scan */
+typedef enum { FileSource, FileBinary, FileGenerated, FileMinified } FILEKIND;
+
+/* Handling of binary, generated and minified files */
+typedef enum { SpecialCount, SpecialQuick, SpecialSkip } SPECIALPOLICY;
+
+/*
+ * Coding styles for column 0 function detection. StyleKR, which is also
+ * the Linux kernel style, takes a '{' in column 0 after a column 0 header
+ * as a function; StyleAllman and StyleGnu also put struct and initializer
+ * braces in column 0, so the header must hold a parameter list, and
+ * StyleGnu puts the return type of a function on a line of its own above
+ * its name.
+ */
+typedef enum { StyleKR, StyleAllman, StyleGnu } STYLE;
+
+/* a --style pattern=style option, split when the options are read */
+struct style_rule {
+	char *pattern;
+	STYLE style;
+};
+
+struct style_list {
+	struct style_rule *rules;
+	int count;
+	int size;
+};
+
+/* Deepest #if nesting tracked for dead code */
+#define MAX_NEST 64
+
+/* Default average line length above which a file is minified */
+#define MINIFIED_LEN 300
+
+/*
+ * Preprocessor conditionals seen while skipping dead code. For each level
+ * of #if nesting, taken records whether a branch has been live: 0 no,
+ * 1 yes, 2 unknown because its condition could not be evaluated.
+ */
+struct pp_state {
+	int depth;		/* #if nesting depth */
+	int dead_depth;		/* depth of the #if whose branch is dead, 0 if live */
+	char taken[MAX_NEST + 1];
+};
+
+/* which budget, if any, stopped the count of a file */
+typedef enum {
+	WithinBudget, OverFunction, OverFile
+} BUDGET;
+
+/*
+ * Function detection by brace matching (--braces). A small lexer skips
+ * comments, string and character literals and preprocessor lines, and a
+ * stack records what each open brace belongs to. Functions are found
+ * inside namespaces, classes and extern "C" blocks at any depth, with
+ * the opening brace anywhere; the header of a function is the text since
+ * the last ';', '{' or '}' at its depth.
+ */
+typedef enum {
+	LexCode, LexLineComment, LexBlockComment, LexString, LexChar,
+	LexDirective
+} LEXSTATE;
+
+typedef enum { ScopeContainer, ScopeFunction, ScopeOther } SCOPEKIND;
+
+#define MAX_SCOPE 256
+#define HEADER_LEN (2 * BUF_LEN)
+#define MAX_CLOSED (BUF_LEN / 4)
+
+/* a function found by brace matching */
+struct brace_fn {
+	char name1[BUF_LEN];
+	char name2[BUF_LEN];
+	struct fn_pos pos;
+	int loc;
+	struct fn_metrics metrics;
+};
+
+struct scope_state {
+	LEXSTATE lex;
+	char prev;		/* previous character scanned */
+	int blank_line;		/* only blanks so far on this line */
+	int depth;		/* number of open braces */
+	char kind[MAX_SCOPE];	/* SCOPEKIND of each open brace, from 1 */
+	int fn_depth;		/* depth of the open function, 0 if none */
+	int touched;		/* a function was open during this chunk */
+	char header[HEADER_LEN];	/* text since the last ; { or } */
+	int header_len;
+	int header_line;	/* line and offset where the header started */
+	long header_offset;
+	int line_no;		/* line and offsets of the chunk scanned */
+	long line_offset;
+	long end_offset;
+	struct brace_fn open_fn;	/* the function being counted */
+	struct brace_fn closed[MAX_CLOSED];	/* functions closed in the chunk */
+	int closed_count;
+	char word[16];		/* identifier being read, for --metrics */
+	int word_len;
+	int base_depth;		/* depth of the function's opening brace */
+	struct fn_metrics metrics;	/* complexity since the function opened */
+};
+
+/* totals for each source code file counted */
+struct file_data {
+	char *file;		/* file name, owned by the path table */
+	int prg_loc;
+	int fn_count;
+	int fn_loc;
+	FILEKIND kind;		/* what the pre-scan found */
+	int skipped;		/* the file was not counted */
+	int dead_loc;		/* non-blank lines in disabled #if regions */
+	BUDGET over;		/* budget exceeded, counting stopped early */
+	int over_line;		/* line on which the budget was exceeded */
+	node *over_fn;		/* function over budget */
+	node *first_fn;		/* first function of the file in the list */
+	int end_state;		/* line state at the end of the file */
+	int seq;		/* position of the file in the list counted */
+	int lines;		/* physical lines read */
+	long bytes;		/* bytes read */
+	struct file_data *next;
+};
+
+struct file_data *files;
+struct file_data *last_file;
+
+/* Source code encodings */
+typedef enum { EncUnknown, EncBytes, EncUtf16LE, EncUtf16BE } ENCODING;
+
+/*
+ * source code to count: an open stream, or a block of memory. A stream is
+ * read a block at a time into block and split into lines from there.
+ * UTF-16 source code, from a stream or memory, is read into wide and
+ * transcoded to UTF-8 in block a piece at a time.
+ */
+struct input {
+	int fd;			/* file to read, -1 to read fp or data */
+	int at_end;		/* fd has been read to the end */
+	long expect;		/* bytes left in a small regular file, or -1 */
+	char *feed;		/* --self-test: bytes put in a pipe before each */
+	long feed_left;		/* read(), chunk at a time, through feed_fd */
+	long chunk;
+	int feed_fd;
+	char *name;		/* name of the file, for errors */
+	FILE *fp;		/* stream to read, NULL to read data */
+	char *data;		/* source code held in memory */
+	long size;		/* number of bytes in data */
+	long pos;		/* next byte of data to read */
+	long raw;		/* bytes taken by the last chunk read */
+	long bias;		/* bytes skipped before the next chunk (BOM) */
+	int eol;		/* last chunk read ended a line */
+	ENCODING encoding;
+	char *src;		/* UTF-16 source code held in memory */
+	long src_size;
+	long src_pos;
+	unsigned char wide[WIDE_LEN];	/* UTF-16 waiting to be transcoded */
+	long wide_len;
+	unsigned high;		/* high surrogate waiting for its pair */
+	double read_time;	/* seconds spent reading fd or fp */
+	char block[BLOCK_LEN];
+};
+
+/* totals counted for a blob in a history stream */
+struct blob_memo {
+	char id[ID_LEN];
+	int prg_loc;
+	int fn_count;
+	int fn_loc;
+};
+
+/* text built in memory */
+struct text {
+	char *data;
+	long len;
+	long size;
+};
+
+/* a file of the list for --sample, with the length of its directory */
+struct sample_item {
+	char *name;
+	int dir_len;
+};
+
+/* running sums of a measure over the files sampled */
+struct sample_sum {
+	double total;		/* estimated total */
+	double var;		/* variance of the estimated total */
+	double seen;		/* total of the files counted */
+};
+
+/* a function found by the reference scanner of --self-test */
+struct ref_fn {
+	char name1[BUF_LEN];
+	char name2[BUF_LEN];
+	int loc;
+};
+
+/* results of the reference scanner */
+struct ref_result {
+	int prg_loc;
+	int fn_count;
+	int fn_loc;
+	int state;		/* line state at the end of the source */
+	struct ref_fn *fns;
+	int count;
+	int size;
+};
+
+/* functions and files loaded for a comparison */
+struct result_set {
+	node *fns;
+	struct file_data *files;
+	int fn_count;
+	int file_count;
+};
+
+/*
+ * Function index file layout: an idx_header, then idx_header.count fixed
+ * size idx_rec records sorted by key, then file, then start line, then
+ * the same records as idx_loc entries sorted by LOC, largest first, then
+ * idx_header.file_count idx_file records holding the file totals, then
+ * the string table. Records hold the offsets of their names in the string
+ * table, which starts with the empty string, so every record has a fixed
+ * width and the file can be searched in place with fseek(). In the file
+ * every field is a little-endian integer of the width given here, in the
+ * order given, with no padding, so an index written on one platform can
+ * be read on any other.
+ */
+struct idx_header {
+	char magic[8];
+	int32_t rec_size;
+	int32_t count;
+	int32_t file_rec_size;
+	int32_t file_count;
+	int64_t loc_pos;	/* file offsets of the sections */
+	int64_t file_pos;
+	int64_t str_pos;
+	int64_t str_size;	/* bytes in the string table */
+};
+
+struct idx_rec {
+	int64_t key;		/* function name taken from the header */
+	int64_t name1;
+	int64_t name2;
+	int64_t file;
+	int64_t start_offset;
+	int64_t end_offset;
+	int32_t start_line;
+	int32_t end_line;
+	int32_t loc;
+	int32_t branches;
+	int32_t depth;
+	int32_t returns;
+};
+
+struct idx_loc {
+	int32_t loc;
+	int32_t rec;		/* position of the record in key order */
+};
+
+struct idx_file {
+	int64_t file;		/* offset of the name in the string table */
+	int32_t seq;		/* position of the file in the list counted */
+	int32_t prg_loc;
+	int32_t fn_count;
+	int32_t fn_loc;
+	int32_t kind;
+	int32_t skipped;
+	int32_t dead_loc;
+};
+
+/*
+ * An index record together with its names, as merged by write_index(),
+ * held in the --max-memory runs and read back from an index file.
+ */
+struct idx_entry {
+	struct idx_rec rec;
+	char key[BUF_LEN];
+	char name1[BUF_LEN];
+	char name2[BUF_LEN];
+	char file[PATH_LEN];
+};
+
+struct idx_file_entry {
+	struct idx_file rec;
+	char file[PATH_LEN];
+};
+
+/*
+ * Line classes for the line map. Each physical line is stored in one 4 bit
+ * nibble: the low 3 bits hold the class and LM_LOC is set if the line
+ * completed a logical line of code that was counted.
+ */
+typedef enum {
+	LineBlank, LineComment, LineCode, LineContinued, LineDirective,
+	LineBrace, LineDead
+} LINECLASS;
+
+#define LM_LOC 0x08
+
+/* Line map flags gathered while a physical line is scanned */
+#define LM_CODE 0x01		/* a non-blank character outside a comment */
+#define LM_TEXT 0x02		/* any non-blank character */
+#define LM_NONBRACE 0x04	/* a character other than a brace or ';' */
+#define LM_DIRECTIVE 0x08	/* line starts a compiler directive */
+#define LM_COUNTED 0x10		/* line was counted as a line of code */
+#define LM_DEAD 0x20		/* line is in a disabled #if region */
+
+/*
+ * Line map file layout: an lm_header, (lines + 1) / 2 bytes of packed
+ * nibbles (line n is in the low nibble of byte n / 2 when n is even and
+ * the high nibble when n is odd), then lines + 1 int byte offsets giving
+ * the start of every line and the size of the file.
+ */
+struct lm_header {
+	char magic[8];
+	int lines;
+	int bits;
+};
+
+/* line map built while scanning */
+struct line_map {
+	unsigned char *classes;	/* one class byte per line, packed on output */
+	int *offsets;		/* byte offset of every line */
+	int lines;		/* number of lines mapped */
+	int size;		/* number of lines allocated */
+	int flags;		/* LM_ flags for the current line */
+};
+
+struct line_map lmap;
+
+/* names of the source code files to count */
+struct name_list {
+	char **names;
+	int count;
+	int size;
+};
+
+/* command line options */
+struct options {
+	char *index_file;	/* --index: write function index here */
+	char *line_map;		/* --line-map: write line map here */
+	int positions;		/* --positions: show function lines and offsets */
+	int null_names;		/* -0: read NUL separated names from stdin */
+	SPECIALPOLICY special;	/* --special: binary, generated, minified */
+	struct name_list markers; /* --marker: text marking generated files */
+	int minified_len;	/* --minified: average line length */
+	int dead_code;		/* --dead-code: skip disabled #if regions */
+	struct name_list undefs; /* -U: macros known to be undefined */
+	int max_fn_loc;		/* --max-fn-loc: function budget, 0 for none */
+	int max_file_loc;	/* --max-file-loc: file budget, 0 for none */
+	int fail_fast;		/* --fail-fast: stop at the first file over */
+	int shard;		/* --shard: this shard, 1 to shards */
+	int shards;		/* --shard: number of shards, 0 for none */
+	int merge;		/* --merge: combine function indexes */
+	int braces;		/* --braces: find functions by brace matching */
+	STYLE style;		/* --style: default coding style */
+	struct style_list styles; /* --style: pattern=style for some files */
+	int metrics;		/* --metrics: show the complexity of functions */
+	double sample;		/* --sample: fraction of files, 0 for all */
+	unsigned seed;		/* --seed: random seed for --sample */
+	long max_memory;	/* --max-memory: bytes, 0 for no limit */
+	int progress;		/* --progress: show progress on stderr */
+	int progress_fd;	/* --progress-fd: write progress here, 0 for none */
+	char *prom_file;	/* --prometheus: write metrics here */
+	int prom_interval;	/* --prometheus-interval: seconds between writes */
+	int tu;			/* --tu: count translation units */
+	struct name_list include_dirs; /* -I: directories searched for headers */
+};
+
+struct options opts;
+
+/*
+ * Results moved out of memory to stay under --max-memory. Function index
+ * records go to sorted runs, one after another in a single temporary
+ * file, merged by write_index(); file records are kept in the order
+ * counted together with their totals.
+ */
+struct spill_data {
+	long used;		/* bytes held by the lists, headers and paths */
+	FILE *runs;		/* sorted runs of struct idx_entry */
+	long *run_start;	/* first record of each run in runs */
+	int run_count;
+	int fn_records;		/* records in all the runs */
+	FILE *files;		/* struct idx_file_entry records */
+	int file_count;
+	int fn_count;		/* totals of the spilled files */
+	int fn_loc;
+	int prg_loc;
+	int skipped;
+	int dead_loc;
+	int over;
+};
+
+struct spill_data spill;
+
+/* Records of a spilled run read at a time while the runs are merged */
+#define RUN_BLOCK 16
+
+struct run_reader {
+	long next;		/* next record of the run to read from runs */
+	long end;		/* record after the last of the run */
+	int pos;		/* next record in buf */
+	int got;		/* records in buf */
+	struct idx_entry buf[RUN_BLOCK];
+};
+
+/* Progress of a multi-file run, reported at most once a second */
+struct progress_data {
+	time_t start;		/* time the run started */
+	time_t shown;		/* time of the last report */
+	int done;		/* files counted */
+	int found;		/* files to count */
+	double bytes;		/* bytes and lines read */
+	double lines;
+	char slowest[PATH_LEN];	/* the file that took longest to count */
+	double slowest_time;	/* seconds taken to count it */
+	int width;		/* length of the last progress line */
+};
+
+struct progress_data progress;
+
+/* Stages of counting a file timed for --prometheus */
+typedef enum { StageRead, StageScan, StageFormat, STAGES } STAGE;
+
+/* Upper bounds in seconds of the latency histogram buckets */
+#define LATENCY_BUCKETS	6
+#define LATENCY_BOUNDS	{ 0.0001, 0.001, 0.01, 0.1, 1.0, 10.0 }
+
+struct latency {
+	double count;
+	double sum;			/* seconds */
+	double buckets[LATENCY_BUCKETS + 1];	/* the last is +Inf */
+};
+
+/* Counters exported by --prometheus */
+struct prom_data {
+	time_t written;		/* time the metrics file was last written */
+	double files;		/* files and blobs counted */
+	double bytes;
+	double lines;
+	double cache_hits;	/* --history blobs already counted */
+	double cache_misses;
+	struct latency stage[STAGES];
+};
+
+struct prom_data prom;
+
+/*
+ * A file reached by --tu, counted once per run. Its includes are the
+ * units of the headers it includes that were found.
+ */
+struct unit_file {
+	char file[PATH_LEN];
+	int counted;		/* the file has been counted */
+	int prg_loc;
+	int fn_count;
+	int fn_loc;
+	int *includes;
+	int include_count;
+	int tu_count;		/* translation units that reach the file */
+	int mark;		/* last translation unit that reached it, + 1 */
+};
+
+/* the files reached by a translation unit, the unit itself first */
+struct trans_unit {
+	int *files;
+	int count;
+};
+
+struct unit_table {
+	struct unit_file *list;
+	int count;
+	int size;		/* units allocated in list */
+	int *slots;		/* hash table of unit + 1, 0 when empty */
+	int slot_count;		/* a power of 2 */
+	int counted;		/* files counted */
+};
+
+struct unit_table units;
+
+/* "name or <name of the #include lines found by count_file() for --tu */
+struct name_list found_includes;
+
 /* Line states */
 typedef enum {
 	NewLine, NewLineNC, PosComment, CppComment, Comment,
@@ -60,12 +639,186 @@ STATETYPE next_close_bracket2(char ch);
 STATETYPE next_pos_eol(char ch);
 STATETYPE next_inline_comment(char ch);
 
+/* counting */
+void cleanup(struct name_list *names);
+int count_source(char source[], int first);
+void print_file(struct file_data *rec, int first);
+struct file_data *count_file(struct input *in, char source[]);
+FILEKIND prescan(struct input *in);
+int has_marker(char data[], long len, char marker[]);
+char *kind_name(FILEKIND kind);
+int input_eof(struct input *in);
+void detect_encoding(struct input *in);
+long read_source(struct input *in, unsigned char dst[], long len);
+long fill_utf16(struct input *in);
+char *read_chunk(char buffer[], int len, struct input *in);
+int open_source(struct input *in, char source[]);
+void start_source(struct input *in, int fd, char source[]);
+void close_source(struct input *in);
+
+/* shards */
+int in_shard(char name[]);
+int merge_results(struct name_list *parts);
+int compare_fn_file(const void *a, const void *b);
+int compare_file_name(const void *a, const void *b);
+int compare_file_seq(const void *a, const void *b);
+
+/* sampling */
+int sample_files(struct name_list *names);
+int compare_sample_dir(const void *a, const void *b);
+void add_stratum(struct sample_sum *sum, double x[], int m, int n);
+void print_estimate(char label[], struct sample_sum *sum);
+
+/* budget gate */
+int check_budget(char source[]);
+
+/* coding styles */
+int parse_style(char name[], STYLE *style);
+void add_style(struct style_list *list, char pattern[], int len, STYLE style);
+void free_styles(struct style_list *list);
+STYLE style_for(char source[]);
+int match_pattern(char pattern[], char name[]);
+
+/* brace matching */
+void scan_scope(struct scope_state *sc, char ch);
+void add_header(struct scope_state *sc, char ch);
+void end_word(struct scope_state *sc);
+void open_scope(struct scope_state *sc);
+void close_scope(struct scope_state *sc);
+SCOPEKIND classify_header(char header[]);
+int is_word(char text[], char *at, char word[]);
+void split_header(char header[], char name1[], char name2[]);
+
+/* dead code */
+int dead_region(char line[], struct pp_state *pp);
+int eval_condition(char expr[]);
+int is_undef(char name[], int len);
+
 /* functions for the list */
-void insert_at_end(char fn_name1[], char fn_name2[], int fn_loc);
+void insert_at_end(char fn_name1[], char fn_name2[], char file[],
+		   struct fn_pos *pos, int fn_loc);
 node *free_list(node *head);
+int intern_header(char fn_name1[], char fn_name2[]);
+void free_headers(void);
+char *intern_path(char file[]);
+struct path *find_path(char file[]);
+void free_paths(void);
+struct file_data *insert_file(char file[]);
+struct file_data *free_files(struct file_data *files);
+
+/* file names */
+void add_name(struct name_list *list, char name[]);
+void read_list_file(struct name_list *list, char list_file[]);
+void read_null_names(struct name_list *list);
+void collect_names(struct name_list *list, char arg[]);
+void add_tree(struct name_list *list, char dir[]);
+int is_source_name(char name[]);
+int compare_name(const void *a, const void *b);
+void free_names(struct name_list *list);
+
+/* translation units */
+int count_units(struct name_list *names);
+int reach_unit(int id, int tu, struct trans_unit *unit);
+void count_unit(int id);
+int find_unit(char file[]);
+unsigned long hash_path(char file[]);
+int same_path(char a[], char b[]);
+void note_include(char line[]);
+int resolve_include(char path[], char name[], char from[]);
+void clean_path(char path[]);
+void print_unit(char file[], struct trans_unit *unit);
+void free_units(void);
+
+/* memory ceiling */
+long parse_size(char arg[]);
+void check_memory(void);
+void spill_results(void);
+int read_run(struct run_reader *run, struct idx_entry *entry);
+node **sort_list(int *count);
+int compare_fn_ptr(const void *a, const void *b);
+void make_idx_entry(struct idx_entry *entry, node *fn);
+void make_idx_file(struct idx_file_entry *fentry, struct file_data *file);
+void free_spill(void);
+
+/* function index */
+void fn_key(char key[], char fn_name1[], char fn_name2[]);
+int compare_idx_entry(const void *a, const void *b);
+int compare_idx_loc(const void *a, const void *b);
+void write_index(char index_file[]);
+int64_t write_idx_str(FILE *sp, int64_t *size, char str[]);
+int64_t write_idx_path(FILE *sp, int64_t *size, char file[]);
+void index_write_error(FILE *ip, char index_file[]);
+void put_le(unsigned char buf[], int64_t value, int size);
+int64_t get_le(unsigned char buf[], int size);
+int write_idx_header(FILE *ip, struct idx_header *hdr);
+int read_idx_header(FILE *ip, struct idx_header *hdr);
+int write_idx_rec(FILE *ip, struct idx_rec *rec);
+int read_idx_rec(FILE *ip, struct idx_rec *rec);
+int write_idx_loc(FILE *ip, struct idx_loc *loc);
+int read_idx_loc(FILE *ip, struct idx_loc *loc);
+int write_idx_file(FILE *ip, struct idx_file *frec);
+int read_idx_file(FILE *ip, struct idx_file *frec);
+FILE *open_index(char index_file[], struct idx_header *hdr);
+int load_index(FILE *ip, struct idx_header *hdr, char index_file[]);
+char *idx_str(char table[], struct idx_header *hdr, int64_t offset);
+int read_idx_entry(FILE *ip, struct idx_header *hdr, int64_t n, struct idx_entry *entry);
+int read_idx_field(FILE *ip, struct idx_header *hdr, int64_t offset, char str[], int size);
+int find_in_index(char index_file[], char name[]);
+int list_index_over(char index_file[], int min_loc);
+void print_idx_rec(struct idx_entry *entry);
+
+/* commit history sweep */
+int count_history(char stream[]);
+FILE *binary_stdin(void);
+struct blob_memo *find_blob(struct blob_memo *memo, int size, char id[]);
+void print_commit(char commit[], int file_count, int prg_loc, int fn_count,
+		  int fn_loc);
+
+/* framed record stream */
+int count_stream(void);
+void format_result(struct file_data *rec, struct text *out);
+void text_printf(struct text *out, const char *format, ...);
+
+/* comparison of two result sets */
+void load_results(char arg[], struct result_set *set);
+unsigned long hash_fn(node *fn, int use_file);
+int compare_results(char old_arg[], char new_arg[]);
+void print_delta(char label[], int old_val, int new_val);
+
+/* line map */
+void map_char(char ch, STATETYPE st);
+void map_line(long line_offset);
+void write_line_map(char map_file[], long file_size);
+
+/* progress */
+void start_progress(struct name_list *names);
+void file_progress(char source[], struct file_data *rec, double seconds);
+void show_progress(int final);
+
+/* metrics export */
+double wall_clock(void);
+void observe_stage(STAGE stage, double seconds);
+void count_metrics(struct file_data *rec);
+void update_metrics(int final);
+void write_metrics(char metrics_file[]);
+void print_latency(FILE *mp, char stage[], struct latency *lat);
+
+/* self-test */
+int self_test(int cases, unsigned long seed);
+unsigned long next_random(unsigned long *seed);
+void make_case(struct text *src, unsigned long *seed);
+int open_case(struct input *in, struct text *src, long chunk);
+void feed_pipe(struct input *in);
+void reference_count(FILE *sp, struct ref_result *ref);
+void keep_result(struct file_data *rec, struct ref_result *ref);
+int check_engine(char engine[], struct input *in, struct ref_result *ref,
+		 int n);
 
 /* display functions */
 void print_intro(char source[]);
-void print_fn_data(char source[], int fn_count, int prg_loc);
+void print_banner(void);
+void print_title(char source[]);
+void print_fn_data(char source[], node *first, int fn_count, int prg_loc);
 void print_summary(int fn_count, int total_fn_loc, int prg_loc);
+void print_totals(void);
 void show_usage(char p_name[]);
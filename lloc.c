@@ -45,15 +45,25 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
 #include "lloc.h"
 
 int main(int argc, char *argv[])
 {
         FILE *fp;
-        char buffer[BUFF_LEN];
-        STATETYPE state = NewLine;
-        int loc = 0;
-        int i;
+        struct name_list names;
+        int null_names = 0;
+        int loc;
+        int total = 0;
+        int counted = 0;
+        int status = 0;
+        int arg;
+        int n;
+
+        memset(&names, 0, sizeof(names));
 
         if ( argc < 2 )
 	{
@@ -62,23 +72,95 @@ int main(int argc, char *argv[])
 		exit(1);
 	}
 
-	if ( (strcmp(argv[1], "-h") == 0) || (strcmp(argv[1], "--help") == 0) )
+	for ( arg = 1; arg < argc && argv[arg][0] == '-'; arg++ )
 	{
-		 show_usage(argv[0]);
-		 exit(1);
+		if ( (strcmp(argv[arg], "-h") == 0) || (strcmp(argv[arg], "--help") == 0) )
+		{
+			 show_usage(argv[0]);
+			 exit(1);
+		}
+		else if ( strcmp(argv[arg], "-0") == 0 )
+			null_names = 1;
+		else
+		{
+			fprintf(stderr, "Invalid option %s\n", argv[arg]);
+			show_usage(argv[0]);
+			exit(1);
+		}
 	}
 
-        fp = fopen(argv[1], "r");
-        if( fp == NULL )
+	for ( ; arg < argc; arg++ )
+		if ( argv[arg][0] == '@' )
+			read_list_file(&names, argv[arg] + 1);
+		else
+			add_name(&names, argv[arg]);
+	if ( null_names )
+		read_null_names(&names);
+
+	if ( names.count == 0 )
+	{
+		fprintf(stderr, "No source code file passed.\n");
+		show_usage(argv[0]);
+		exit(1);
+	}
+
+        for ( n = 0; n < names.count; n++ )
         {
-                fprintf(stderr, "Cannot open %s\n", argv[1]);
-                show_usage(argv[0]);
-                exit(1);
+                fp = fopen(names.names[n], "rb");
+                if( fp == NULL )
+                {
+                        fprintf(stderr, "Cannot open %s\n", names.names[n]);
+                        if ( names.count == 1 )
+                        {
+                                show_usage(argv[0]);
+                                exit(1);
+                        }
+                        status = 1;
+                        continue;
+                }
+
+                loc = count_loc(fp);
+                if ( counted++ == 0 )
+                        printLoc(names.names[n], loc);
+                else
+                        printFileLoc(names.names[n], loc);
+                total += loc;
+
+                /* Clean up - close the file */
+                fclose(fp);
         }
 
-        while( !feof(fp) )
+        if ( names.count > 1 )
+                printTotalLoc(counted, total);
+
+        free_names(&names);
+
+        return(status);
+}
+
+/*
+ * FUNCTION
+ *	int count_loc(FILE *fp)
+ * DESCRIPTION
+ *	Counts the logical lines of code in an open source code file.
+ * PARAMETERS
+ *	FILE *fp - the source code file, open for reading
+ * RETURN VALUE
+ *	The number of logical lines of code.
+ */
+int count_loc(FILE *fp)
+{
+        char buffer[BUFF_LEN];
+        struct decoder dec;
+        STATETYPE state = NewLine;
+        int loc = 0;
+        int i;
+
+        detect_encoding(fp, &dec);
+
+        while( !feof(fp) || dec.pos < dec.n )
         {
-                if( fgets(buffer, BUFF_LEN, fp) )
+                if( read_line(buffer, BUFF_LEN, fp, &dec) )
                 {
                         for( i = 0; i < strlen(buffer); i++ )
                         {
@@ -132,15 +214,317 @@ int main(int argc, char *argv[])
                                 loc++;
                         else if( state == NewLineNC )
                                 state = NewLine;
-                } /* end if( fgets(... */
+                } /* end if( read_line(... */
         } /* end while loop */
 
-        printLoc(argv[1], loc);
+        return loc;
+}
+
+/*
+ * FUNCTION
+ *	char *read_line(char buffer[], int len, FILE *fp, struct decoder *dec)
+ * DESCRIPTION
+ *	Reads the next line of source code, or the next len - 1 characters of
+ *	a longer line, into buffer, as fgets() would. Lines may end with
+ *	"\n", "\r\n" or a bare "\r", in any mix; every line ending is stored
+ *	in buffer as a single '\n' so the line states only see '\n'.
+ * PARAMETERS
+ *	char buffer[] - receives the line
+ *	int len - size of buffer
+ *	FILE *fp - the source code file, open for binary reading
+ *	struct decoder *dec - the encoding of the file
+ * RETURN VALUE
+ *	buffer, or NULL at the end of the file
+ */
+char *read_line(char buffer[], int len, FILE *fp, struct decoder *dec)
+{
+	int n = 0;
+	int ch;
+
+	while ( n < len - 1 && (ch = next_char(fp, dec)) != EOF )
+	{
+		if ( ch == '\r' )
+		{
+			/* put back anything but the '\n' of "\r\n" */
+			if ( (ch = next_char(fp, dec)) != '\n' && ch != EOF )
+			{
+				if ( dec->encoding == EncBytes )
+					ungetc(ch, fp);
+				else
+					dec->pos--;
+			}
+			ch = '\n';
+		}
+
+		buffer[n++] = ch;
+		if ( ch == '\n' )
+			break;
+	}
+
+	if ( n == 0 )
+		return NULL;
+	buffer[n] = '\0';
+
+	return buffer;
+}
+
+/*
+ * FUNCTION
+ *	void detect_encoding(FILE *fp, struct decoder *dec)
+ * DESCRIPTION
+ *	Looks at the first bytes of a source code file for a byte order mark
+ *	or the zero bytes of ASCII text in UTF-16 and skips any byte order
+ *	mark. UTF-16 files are transcoded to UTF-8 by next_char().
+ * PARAMETERS
+ *	FILE *fp - the source code file, open for binary reading
+ *	struct decoder *dec - receives the encoding of the file
+ * RETURN VALUE
+ *	None
+ */
+void detect_encoding(FILE *fp, struct decoder *dec)
+{
+	unsigned char b[4];
+	size_t len;
+	long bom = 0;
+
+	memset(dec, 0, sizeof(*dec));
+	dec->encoding = EncBytes;
+
+	len = fread(b, 1, sizeof(b), fp);
+	if ( len >= 3 && b[0] == 0xef && b[1] == 0xbb && b[2] == 0xbf )
+		bom = 3;
+	else if ( len >= 2 && b[0] == 0xff && b[1] == 0xfe )
+	{
+		dec->encoding = EncUtf16LE;
+		bom = 2;
+	}
+	else if ( len >= 2 && b[0] == 0xfe && b[1] == 0xff )
+	{
+		dec->encoding = EncUtf16BE;
+		bom = 2;
+	}
+	else if ( len == 4 && b[0] && !b[1] && b[2] && !b[3] )
+		dec->encoding = EncUtf16LE;
+	else if ( len == 4 && !b[0] && b[1] && !b[2] && b[3] )
+		dec->encoding = EncUtf16BE;
+
+	fseek(fp, bom, SEEK_SET);
+}
+
+/*
+ * FUNCTION
+ *	int next_char(FILE *fp, struct decoder *dec)
+ * DESCRIPTION
+ *	Returns the next byte of a source code file, transcoding UTF-16 to
+ *	UTF-8 one character at a time. Unpaired surrogates are dropped.
+ * PARAMETERS
+ *	FILE *fp - the source code file, open for binary reading
+ *	struct decoder *dec - the encoding of the file
+ * RETURN VALUE
+ *	The next byte, or EOF at the end of the file
+ */
+int next_char(FILE *fp, struct decoder *dec)
+{
+	unsigned long cp;
+	unsigned unit;
+	unsigned high = 0;
+	int b1, b2;
+
+	if ( dec->pos < dec->n )
+		return dec->out[dec->pos++];
+	if ( dec->encoding == EncBytes )
+		return getc(fp);
+
+	for ( ;; )
+	{
+		if ( (b1 = getc(fp)) == EOF || (b2 = getc(fp)) == EOF )
+			return EOF;
+		if ( dec->encoding == EncUtf16LE )
+			unit = b1 | (b2 << 8);
+		else
+			unit = (b1 << 8) | b2;
+
+		if ( unit >= 0xd800 && unit < 0xdc00 )
+			high = unit;
+		else if ( unit >= 0xdc00 && unit < 0xe000 )
+		{
+			if ( high == 0 )
+				continue;
+			cp = 0x10000 + ((high - 0xd800) << 10) + (unit - 0xdc00);
+			break;
+		}
+		else
+		{
+			cp = unit;
+			break;
+		}
+	}
+
+	dec->pos = 0;
+	if ( cp < 0x80 )
+	{
+		dec->out[0] = cp;
+		dec->n = 1;
+	}
+	else if ( cp < 0x800 )
+	{
+		dec->out[0] = 0xc0 | (cp >> 6);
+		dec->out[1] = 0x80 | (cp & 0x3f);
+		dec->n = 2;
+	}
+	else if ( cp < 0x10000 )
+	{
+		dec->out[0] = 0xe0 | (cp >> 12);
+		dec->out[1] = 0x80 | ((cp >> 6) & 0x3f);
+		dec->out[2] = 0x80 | (cp & 0x3f);
+		dec->n = 3;
+	}
+	else
+	{
+		dec->out[0] = 0xf0 | (cp >> 18);
+		dec->out[1] = 0x80 | ((cp >> 12) & 0x3f);
+		dec->out[2] = 0x80 | ((cp >> 6) & 0x3f);
+		dec->out[3] = 0x80 | (cp & 0x3f);
+		dec->n = 4;
+	}
+
+	return dec->out[dec->pos++];
+}
+
+/*
+ * FUNCTION
+ *	void add_name(struct name_list *list, char name[])
+ * DESCRIPTION
+ *	Adds a copy of a source code file name to a list of names.
+ * PARAMETERS
+ *	struct name_list *list - the list of names
+ *	char name[] - the file name
+ * RETURN VALUE
+ *	None, exits if out of memory
+ */
+void add_name(struct name_list *list, char name[])
+{
+	if ( list->count == list->size )
+	{
+		list->size = list->size ? list->size * 2 : 64;
+		list->names = realloc(list->names, list->size * sizeof(char *));
+		if ( list->names == NULL )
+		{
+			fprintf(stderr, "Out of space\n");
+			exit(1);
+		}
+	}
+
+	list->names[list->count] = malloc(strlen(name) + 1);
+	if ( list->names[list->count] == NULL )
+	{
+		fprintf(stderr, "Out of space\n");
+		exit(1);
+	}
+	strcpy(list->names[list->count++], name);
+}
+
+/*
+ * FUNCTION
+ *	void read_list_file(struct name_list *list, char list_file[])
+ * DESCRIPTION
+ *	Adds the file names in a response file, one per line, to a list of
+ *	names. Blank lines are skipped.
+ * PARAMETERS
+ *	struct name_list *list - the list of names
+ *	char list_file[] - name of the response file
+ * RETURN VALUE
+ *	None, exits if the response file cannot be opened or holds a name
+ *	too long for PATH_LEN
+ */
+void read_list_file(struct name_list *list, char list_file[])
+{
+	char name[PATH_LEN];
+	FILE *lp;
+	int ch;
+
+	lp = fopen(list_file, "r");
+	if ( lp == NULL )
+	{
+		fprintf(stderr, "Cannot open %s\n", list_file);
+		exit(1);
+	}
+
+	while ( fgets(name, PATH_LEN, lp) )
+	{
+		if ( strchr(name, '\n') == NULL && (ch = getc(lp)) != EOF && ch != '\n' )
+		{
+			fprintf(stderr, "File name too long in %s: %.40s...\n", list_file, name);
+			exit(1);
+		}
+		name[strcspn(name, "\r\n")] = '\0';
+		if ( strcmp(name, "") != 0 )
+			add_name(list, name);
+	}
+	fclose(lp);
+}
 
-        /* Clean up - close the file */
-        fclose(fp);
+/*
+ * FUNCTION
+ *	void read_null_names(struct name_list *list)
+ * DESCRIPTION
+ *	Adds the NUL separated file names read from standard input, as
+ *	written by find -print0, to a list of names.
+ * PARAMETERS
+ *	struct name_list *list - the list of names
+ * RETURN VALUE
+ *	None, exits if a name is too long for PATH_LEN
+ */
+void read_null_names(struct name_list *list)
+{
+	char name[PATH_LEN];
+	int ch;
+	int n = 0;
+
+#ifdef _WIN32
+	_setmode(_fileno(stdin), _O_BINARY);
+#endif
+	while ( (ch = getchar()) != EOF )
+	{
+		if ( ch != '\0' && n == PATH_LEN - 1 )
+		{
+			name[n] = '\0';
+			fprintf(stderr, "File name too long: %.40s...\n", name);
+			exit(1);
+		}
+		else if ( ch != '\0' )
+			name[n++] = ch;
+		else
+		{
+			name[n] = '\0';
+			if ( n > 0 )
+				add_name(list, name);
+			n = 0;
+		}
+	}
+	name[n] = '\0';
+	if ( n > 0 )
+		add_name(list, name);
+}
 
-        return(0);
+/*
+ * FUNCTION
+ *	void free_names(struct name_list *list)
+ * DESCRIPTION
+ *	frees the memory allocated for a list of names
+ * PARAMETERS
+ *	struct name_list *list - the list of names
+ * RETURN VALUE
+ *	None
+ */
+void free_names(struct name_list *list)
+{
+	int n;
+
+	for ( n = 0; n < list->count; n++ )
+		free(list->names[n]);
+	free(list->names);
+	memset(list, 0, sizeof(*list));
 }
 
 /*
@@ -549,9 +933,42 @@ void printLoc(char source[], int loc)
 	printf("\nLLoC 1.0\n");
 	printf("Copyright 2019 Richard B. Romig\n");
 	printf("Licensed under the GNU General Public License, version 2\n\n");
+	printFileLoc(source, loc);
+}
+
+/*
+ * FUNCTION
+ *	void printFileLoc(char source[], int loc)
+ * DESCRIPTION
+ *	displays the lines of code counted in one source code file
+ * PARAMETERS
+ *	char source[] - character string containing the name of the source
+ *			code file
+ *	int loc - lines of code counted in the file
+ * RETURN VALUE
+ *	None
+ */
+void printFileLoc(char source[], int loc)
+{
 	printf("Lines of code for %s:\t%d\n\n", source, loc);
 }
 
+/*
+ * FUNCTION
+ *	void printTotalLoc(int file_count, int loc)
+ * DESCRIPTION
+ *	displays the combined lines of code of all the files counted
+ * PARAMETERS
+ *	int file_count - number of files counted
+ *	int loc - lines of code counted in all the files
+ * RETURN VALUE
+ *	None
+ */
+void printTotalLoc(int file_count, int loc)
+{
+	printf("Lines of code for %d files:\t%d\n\n", file_count, loc);
+}
+
 /* FUNCTION
  *	void show_usage(char p_name[])
  * DESCRIPTION
@@ -568,8 +985,12 @@ void printLoc(char source[], int loc)
 */
 void show_usage(char p_name[])
 {
- 	printf("\tUsage: %s filename\n", p_name);
+ 	printf("\tUsage: %s filename...\n", p_name);
+ 	printf("\t       %s @listfile\n", p_name);
+ 	printf("\t       %s -0 < names\n", p_name);
  	printf("\tWhere filename is a C or C++ source code or header file.\n");
+ 	printf("\t@listfile names a file listing one source code file per line.\n");
+ 	printf("\t-0 reads NUL separated file names from standard input.\n");
  	printf("\tSee README for information regarding style requirements\n");
  	printf("\tand limitations.\n\n");
 }
@@ -29,6 +29,27 @@
 
 #define BUFF_LEN 128
 
+/* Maximum length of a file name (Windows MAX_PATH) */
+#define PATH_LEN 260
+
+/* Source code encodings */
+typedef enum { EncBytes, EncUtf16LE, EncUtf16BE } ENCODING;
+
+/* UTF-16 to UTF-8 transcoding state for a source code file */
+struct decoder {
+	ENCODING encoding;
+	unsigned char out[4];	/* UTF-8 bytes of the last character */
+	int n;			/* number of bytes in out */
+	int pos;		/* next byte of out to return */
+};
+
+/* names of the source code files to count */
+struct name_list {
+	char **names;
+	int count;
+	int size;
+};
+
 /* Line states */
 typedef enum { NewLine, NewLineNC, PosComment, CppComment,
                Comment, PosEndComment, EndComment, CompDir,
@@ -49,6 +70,20 @@ STATETYPE next_close_bracket2(char ch);
 STATETYPE next_pos_eol(char ch);
 STATETYPE next_inline_comment(char ch);
 
+/* counting */
+int count_loc(FILE *fp);
+char *read_line(char buffer[], int len, FILE *fp, struct decoder *dec);
+void detect_encoding(FILE *fp, struct decoder *dec);
+int next_char(FILE *fp, struct decoder *dec);
+
+/* file names */
+void add_name(struct name_list *list, char name[]);
+void read_list_file(struct name_list *list, char list_file[]);
+void read_null_names(struct name_list *list);
+void free_names(struct name_list *list);
+
 /* display functions */
 void printLoc(char source[], int loc);
+void printFileLoc(char source[], int loc);
+void printTotalLoc(int file_count, int loc);
 void show_usage(char p_name[]);